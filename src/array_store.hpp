@@ -0,0 +1,124 @@
+/**
+ * @file array_store.hpp
+ * @brief Contiguous storage that either owns its elements or views them inside a mapped file
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include "mapped_file.hpp"
+
+/*
+A contiguous array of trivially copyable elements. The elements either live in an owned vector
+or directly inside a memory mapped file, in which case nothing is parsed or copied on load.
+Growing or shrinking a mapped array first copies it into owned memory.
+*/
+template <typename T>
+class ArrayStore {
+    static_assert(std::is_trivially_copyable<T>::value, "ArrayStore elements must be trivially copyable");
+
+    std::vector<T> owned;
+    std::shared_ptr<MappedFile> mapping;
+    T * items = nullptr;
+    std::size_t count = 0;
+
+public:
+    ArrayStore() = default;
+    ArrayStore(const ArrayStore &) = delete;
+    ArrayStore & operator=(const ArrayStore &) = delete;
+    ArrayStore(ArrayStore &&) = default;
+    ArrayStore & operator=(ArrayStore &&) = default;
+
+    // Takes ownership of the given elements
+    void assign(std::vector<T> values) {
+        owned = std::move(values);
+        mapping.reset();
+        items = owned.data();
+        count = owned.size();
+    }
+
+    /**
+     * @brief Uses elements stored inside a mapped file. The caller has checked that the range lies within the file and is aligned
+     *
+     * @param file the mapping, which is kept alive as long as the store refers to it
+     * @param offset the byte offset of the first element in the file
+     * @param size the number of elements
+     */
+    void view(std::shared_ptr<MappedFile> file, std::size_t offset, std::size_t size) {
+        owned.clear();
+        owned.shrink_to_fit();
+        mapping = std::move(file);
+        items = reinterpret_cast<T *>(mapping->data() + offset);
+        count = size;
+    }
+
+    void push_back(const T & value) {
+        detach();
+        owned.push_back(value);
+        items = owned.data();
+        count = owned.size();
+    }
+
+    void pop_back() {
+        detach();
+        owned.pop_back();
+        items = owned.data();
+        count = owned.size();
+    }
+
+    // Copies mapped elements into owned memory so that the store can grow
+    void detach() {
+        if (!mapping) return;
+        owned.assign(items, items + count);
+        mapping.reset();
+        items = owned.data();
+    }
+
+    bool isMapped() const {
+        return mapping != nullptr;
+    }
+
+    T & operator[](std::size_t i) {
+        return items[i];
+    }
+
+    const T & operator[](std::size_t i) const {
+        return items[i];
+    }
+
+    T * data() {
+        return items;
+    }
+
+    const T * data() const {
+        return items;
+    }
+
+    std::size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    T * begin() {
+        return items;
+    }
+
+    T * end() {
+        return items + count;
+    }
+
+    const T * begin() const {
+        return items;
+    }
+
+    const T * end() const {
+        return items + count;
+    }
+};
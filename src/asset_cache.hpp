@@ -0,0 +1,89 @@
+/**
+ * @file asset_cache.hpp
+ * @brief Caches the result of importing an asset under a hash of its content
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+/*
+A directory of preprocessed assets. Each entry is a snapshot named after a 64-bit key that covers
+the content of the source file and every setting the preprocessing depends on, so a changed file
+or setting simply misses the cache and old entries are never used by mistake. Entries are written
+with SnapshotWriter and loaded by mapping them, which makes a hit independent of the asset size
+apart from hashing the source file.
+*/
+class AssetCache {
+    std::filesystem::path directory;
+
+public:
+    explicit AssetCache(const std::string & directory) : directory(directory) {
+    }
+
+    /**
+     * @brief Hashes a block of memory eight bytes at a time. Not cryptographic, only meant to tell assets apart
+     *
+     * @param data the bytes to hash
+     * @param size the number of bytes
+     * @param seed the hash of everything else the key depends on
+     * @return the hash
+     */
+    static uint64_t hash(const void * data, std::size_t size, uint64_t seed = 0) {
+        const unsigned char * bytes = static_cast<const unsigned char *>(data);
+        uint64_t h = seed ^ (size * 0x9e3779b97f4a7c15ull);
+        std::size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes + i, 8);
+            h = (h ^ mix(word)) * 0xff51afd7ed558ccdull;
+            h ^= h >> 29;
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, bytes + i, size - i);
+        return mix(h ^ mix(tail ^ 0x1f));
+    }
+
+    // The file an entry with the given key is stored in
+    std::string pathFor(uint64_t key) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.snap", static_cast<unsigned long long>(key));
+        return (directory / name).string();
+    }
+
+    bool contains(uint64_t key) const {
+        std::error_code error;
+        return std::filesystem::is_regular_file(pathFor(key), error);
+    }
+
+    /**
+     * @brief Creates the cache directory if it does not exist yet
+     *
+     * @return false if the directory cannot be created
+     */
+    bool prepare() const {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if (error) {
+            std::cerr << "Could not create asset cache " << directory << ": " << error.message() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    // The finalizer of splitmix64, spreads every input bit over the whole word
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+};
@@ -0,0 +1,207 @@
+/**
+ * @file benchmark.hpp
+ * @brief Benchmark results, per machine baselines and the statistical test that compares them
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "perf_counters.hpp"
+
+/*
+The wall time of every sample of one benchmark, and its counters summed over all samples
+*/
+struct BenchmarkResult {
+    std::string name;
+    std::vector<double> nanosecondsPerStep;
+    CounterValues counters;
+    uint64_t steps = 0;
+    uint64_t particles = 0;
+    uint64_t stepsPerSample = 0;
+};
+
+inline double median(std::vector<double> values) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+/**
+ * @brief Names the class of machine a benchmark runs on, from the CPU model and the number of hardware threads.
+ * Baselines are only comparable between machines of the same class
+ *
+ */
+inline std::string machineClass() {
+    std::string model = "unknown";
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.compare(0, 10, "model name") == 0 && line.find(':') != std::string::npos) {
+            model = line.substr(line.find(':') + 1);
+            break;
+        }
+    }
+    std::string name;
+    for (char c : model + " " + std::to_string(std::thread::hardware_concurrency()) + " threads") {
+        if (std::isalnum(static_cast<unsigned char>(c))) name += std::tolower(static_cast<unsigned char>(c));
+        else if (!name.empty() && name.back() != '-') name += '-';
+    }
+    while (!name.empty() && name.back() == '-') name.pop_back();
+    return name;
+}
+
+/**
+ * @brief Writes benchmark results as JSON for other tools to consume
+ *
+ * @return false if the file cannot be written
+ */
+inline bool writeBenchmarkJSON(const std::string & path, const std::string & machine, const std::vector<BenchmarkResult> & results) {
+    std::FILE * file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        std::cerr << "Could not write benchmark results " << path << std::endl;
+        return false;
+    }
+    std::fprintf(file, "{\n  \"machine\": \"%s\",\n  \"benchmarks\": [\n", machine.c_str());
+    for (size_t r = 0; r < results.size(); ++r) {
+        const BenchmarkResult & result = results[r];
+        std::fprintf(file, "    {\"name\": \"%s\", \"particles\": %llu, \"steps_per_sample\": %llu, \"median_ns_per_step\": %.1f,\n",
+                     result.name.c_str(), static_cast<unsigned long long>(result.particles),
+                     static_cast<unsigned long long>(result.stepsPerSample), median(result.nanosecondsPerStep));
+        std::fprintf(file, "     \"ns_per_step\": [");
+        for (size_t i = 0; i < result.nanosecondsPerStep.size(); ++i) {
+            std::fprintf(file, "%s%.1f", i ? ", " : "", result.nanosecondsPerStep[i]);
+        }
+        std::fprintf(file, "],\n     \"counters\": {");
+        bool first = true;
+        for (int c = 0; c < static_cast<int>(Counter::Count); ++c) {
+            Counter counter = static_cast<Counter>(c);
+            if (!result.counters.has(counter)) continue;
+            std::fprintf(file, "%s\"%s\": %llu", first ? "" : ", ", counterName(counter),
+                         static_cast<unsigned long long>(result.counters[counter]));
+            first = false;
+        }
+        std::fprintf(file, "}}%s\n", r + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(file, "  ]\n}\n");
+    return std::fclose(file) == 0;
+}
+
+/*
+A stored baseline: the samples of each benchmark on one machine class. The file is text with one
+line per benchmark:
+
+    benchmark <name> <particles> <steps per sample> <ns per step of each sample>...
+
+Results are only compared with a baseline entry of the same name, particle count and steps per
+sample, so changing the scene does not produce false regressions.
+*/
+class BenchmarkBaseline {
+    std::vector<BenchmarkResult> entries;
+
+public:
+    bool load(const std::string & path) {
+        std::ifstream file(path);
+        if (!file) {
+            std::cerr << "No benchmark baseline at " << path << std::endl;
+            return false;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            std::istringstream fields(line);
+            std::string kind;
+            BenchmarkResult entry;
+            fields >> kind >> entry.name >> entry.particles >> entry.stepsPerSample;
+            double sample;
+            while (fields >> sample) entry.nanosecondsPerStep.push_back(sample);
+            if (kind != "benchmark" || entry.nanosecondsPerStep.empty()) {
+                std::cerr << "Invalid line in benchmark baseline " << path << std::endl;
+                return false;
+            }
+            entries.push_back(entry);
+        }
+        return true;
+    }
+
+    static bool save(const std::string & path, const std::string & machine, const std::vector<BenchmarkResult> & results) {
+        std::ofstream file(path, std::ios::trunc);
+        file << "# cloth benchmark baseline v1 for " << machine << "\n";
+        for (const BenchmarkResult & result : results) {
+            file << "benchmark " << result.name << " " << result.particles << " " << result.stepsPerSample;
+            char sample[32];
+            for (double ns : result.nanosecondsPerStep) {
+                std::snprintf(sample, sizeof(sample), " %.1f", ns);
+                file << sample;
+            }
+            file << "\n";
+        }
+        if (!file) std::cerr << "Could not write benchmark baseline " << path << std::endl;
+        return static_cast<bool>(file);
+    }
+
+    // The entry a result is compared with, or nullptr if the baseline has none for the same workload
+    const BenchmarkResult * find(const BenchmarkResult & result) const {
+        for (const BenchmarkResult & entry : entries) {
+            if (entry.name == result.name && entry.particles == result.particles && entry.stepsPerSample == result.stepsPerSample) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+};
+
+/**
+ * @brief One-sided Mann-Whitney U test of whether the values of b tend to be larger than those of a.
+ * Uses the normal approximation with tie and continuity corrections, which is adequate from about
+ * eight samples per side. Unlike a t-test it is not thrown off by the long tail of timing samples
+ *
+ * @return the p-value, small values mean b is significantly larger
+ */
+inline double mannWhitneyGreater(const std::vector<double> & a, const std::vector<double> & b) {
+    struct Ranked {
+        double value;
+        bool fromB;
+    };
+    std::vector<Ranked> all;
+    for (double v : a) all.push_back(Ranked{ v, false });
+    for (double v : b) all.push_back(Ranked{ v, true });
+    std::sort(all.begin(), all.end(), [](const Ranked & x, const Ranked & y) { return x.value < y.value; });
+
+    // Tied values share the mean of their ranks
+    double rankSumB = 0;
+    double tieCorrection = 0;
+    for (size_t i = 0; i < all.size();) {
+        size_t j = i;
+        while (j < all.size() && all[j].value == all[i].value) ++j;
+        double rank = (i + 1 + j) / 2.0;
+        for (size_t k = i; k < j; ++k) {
+            if (all[k].fromB) rankSumB += rank;
+        }
+        double t = j - i;
+        tieCorrection += t * t * t - t;
+        i = j;
+    }
+
+    double n1 = a.size();
+    double n2 = b.size();
+    double n = n1 + n2;
+    if (n1 == 0 || n2 == 0) return 1.0;
+    double u = rankSumB - n2 * (n2 + 1) / 2;
+    double mean = n1 * n2 / 2;
+    double variance = n1 * n2 / 12 * ((n + 1) - tieCorrection / (n * (n - 1)));
+    if (variance <= 0) return 1.0;
+    double z = (u - mean - 0.5) / std::sqrt(variance);
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
@@ -0,0 +1,84 @@
+/**
+ * @file bounded_queue.hpp
+ * @brief A fixed capacity queue used to hand work from the simulation thread to background threads
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+/*
+Thread safe FIFO queue with a fixed capacity. Producers can either wait for room (push)
+or give up immediately when the queue is full (tryPush). Closing the queue wakes up all
+waiting threads, after which consumers drain the remaining items.
+*/
+template <typename T>
+class BoundedQueue {
+    std::deque<T> items;
+    std::size_t capacity;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+
+public:
+    explicit BoundedQueue(std::size_t capacity) : capacity(capacity > 0 ? capacity : 1) {
+    }
+
+    /**
+     * @brief Adds an item to the queue, waiting until there is room for it
+     *
+     * @param item the item to add
+     * @return false if the queue was closed and the item was not added
+     */
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Adds an item to the queue if there is room for it, without waiting
+     *
+     * @param item the item to add, it is only moved from if the call succeeds
+     * @return false if the queue was full or closed
+     */
+    bool tryPush(T & item) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed || items.size() >= capacity) return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest item, waiting until one is available
+     *
+     * @param out receives the item
+     * @return false if the queue is closed and empty
+     */
+    bool pop(T & out) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        out = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // Stops accepting new items and wakes up every waiting thread
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+};
@@ -0,0 +1,279 @@
+/**
+ * @file colliders.hpp
+ * @brief Analytic shapes that particles are pushed out of, tested against batches of particles at a time, and the collider file format
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <glm.hpp>
+#include "mesh_collider.hpp"
+
+enum class ColliderShape : uint32_t {
+    Plane,
+    Sphere,
+    Capsule,
+    Box
+};
+
+/*
+A static shape that particles cannot enter. The meaning of a and b depends on the shape:
+
+    plane    a point on the plane and the unit normal pointing to the free side
+    sphere   the centre, b is unused
+    capsule  the two ends of the segment the radius is measured from
+    box      the centre and the half extents along the axes
+
+Friction is the fraction of the sliding velocity a particle loses when it is pushed out.
+*/
+struct Collider {
+    ColliderShape shape = ColliderShape::Sphere;
+    glm::fvec3 a = glm::fvec3(0);
+    glm::fvec3 b = glm::fvec3(0);
+    float radius = 0;
+    float friction = 0;
+};
+
+/**
+ * @brief Reads colliders from a text file with one collider per line. Analytic shapes take an optional friction at the end:
+ *
+ *     plane <x> <y> <z> <nx> <ny> <nz> [friction]
+ *     sphere <x> <y> <z> <radius> [friction]
+ *     capsule <x0> <y0> <z0> <x1> <y1> <z1> <radius> [friction]
+ *     box <x> <y> <z> <half width> <half height> <half depth> [friction]
+ *     mesh <file> <x> <y> <z> <scale> [<vx> <vy> <vz> <spin>]
+ *
+ * A mesh file is found relative to the collider file. The mesh moves by v and turns by spin radians about
+ * the vertical axis per simulated second
+ *
+ * @param path the file to read
+ * @param colliders receives the analytic colliders in file order
+ * @param meshes receives the mesh colliders in file order
+ * @return false if the file cannot be read or a line is invalid
+ */
+inline bool loadColliders(const std::string & path, std::vector<Collider> & colliders, std::vector<MeshCollider> & meshes) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Could not open colliders " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        std::string kind;
+        fields >> kind;
+        if (kind == "mesh") {
+            std::string meshPath;
+            glm::fvec3 position;
+            float scale = 0;
+            glm::fvec3 velocity(0);
+            float spin = 0;
+            fields >> meshPath >> position.x >> position.y >> position.z >> scale;
+            bool valid = !fields.fail() && scale > 0;
+            if (valid && !(fields >> std::ws).eof()) {
+                fields >> velocity.x >> velocity.y >> velocity.z >> spin;
+                valid = !fields.fail() && (fields.eof() || (fields >> std::ws).eof());
+            }
+            if (!valid) {
+                std::cerr << "Invalid collider on line " << lineNumber << " of " << path << std::endl;
+                return false;
+            }
+            size_t slash = path.find_last_of('/');
+            if (meshPath[0] != '/' && slash != std::string::npos) meshPath = path.substr(0, slash + 1) + meshPath;
+            meshes.emplace_back();
+            if (!meshes.back().load(meshPath, position, scale, velocity, spin)) return false;
+            continue;
+        }
+
+        Collider collider;
+        fields >> collider.a.x >> collider.a.y >> collider.a.z;
+        bool valid = true;
+        if (kind == "plane") {
+            collider.shape = ColliderShape::Plane;
+            fields >> collider.b.x >> collider.b.y >> collider.b.z;
+            valid = glm::dot(collider.b, collider.b) > 0;
+            if (valid) collider.b = glm::normalize(collider.b);
+        }
+        else if (kind == "sphere") {
+            collider.shape = ColliderShape::Sphere;
+            fields >> collider.radius;
+            valid = collider.radius > 0;
+        }
+        else if (kind == "capsule") {
+            collider.shape = ColliderShape::Capsule;
+            fields >> collider.b.x >> collider.b.y >> collider.b.z >> collider.radius;
+            valid = collider.radius > 0;
+        }
+        else if (kind == "box") {
+            collider.shape = ColliderShape::Box;
+            fields >> collider.b.x >> collider.b.y >> collider.b.z;
+            valid = collider.b.x > 0 && collider.b.y > 0 && collider.b.z > 0;
+        }
+        else valid = false;
+        // The friction is optional, but nothing may follow it
+        valid = valid && !fields.fail();
+        if (valid && !fields.eof() && !(fields >> std::ws).eof()) {
+            fields >> collider.friction;
+            valid = !fields.fail() && (fields.eof() || (fields >> std::ws).eof()) && collider.friction >= 0 && collider.friction <= 1;
+        }
+        if (!valid) {
+            std::cerr << "Invalid collider on line " << lineNumber << " of " << path << std::endl;
+            return false;
+        }
+        colliders.push_back(collider);
+    }
+    return true;
+}
+
+/**
+ * @brief Tests whether a collider may reach into an axis aligned box, for skipping groups of particles that are far away.
+ * Capsules are tested with their bounding box, so a true result may still be a miss
+ *
+ * @param collider the collider
+ * @param low the smallest coordinates of the box
+ * @param high the largest coordinates of the box
+ * @return false if no point of the box is inside the collider
+ */
+inline bool colliderOverlaps(const Collider & collider, glm::fvec3 low, glm::fvec3 high) {
+    switch (collider.shape) {
+    case ColliderShape::Plane: {
+        glm::fvec3 centre = (low + high) * 0.5f;
+        glm::fvec3 extent = (high - low) * 0.5f;
+        return glm::dot(collider.b, centre - collider.a) - glm::dot(glm::abs(collider.b), extent) < 0;
+    }
+    case ColliderShape::Sphere: {
+        glm::fvec3 closest = glm::clamp(collider.a, low, high);
+        return glm::dot(closest - collider.a, closest - collider.a) < collider.radius * collider.radius;
+    }
+    case ColliderShape::Capsule: {
+        glm::fvec3 capsuleLow = glm::min(collider.a, collider.b) - collider.radius;
+        glm::fvec3 capsuleHigh = glm::max(collider.a, collider.b) + collider.radius;
+        return glm::all(glm::lessThan(capsuleLow, high)) && glm::all(glm::lessThan(low, capsuleHigh));
+    }
+    case ColliderShape::Box:
+        return glm::all(glm::lessThan(collider.a - collider.b, high)) && glm::all(glm::lessThan(low, collider.a + collider.b));
+    }
+    return false;
+}
+
+// The number of particles tested against a collider at once
+const size_t colliderBatch = 16;
+
+/*
+The positions of up to colliderBatch particles, one array per coordinate. Unused lanes hold NaN, which
+no containment test accepts
+*/
+struct ParticleBatch {
+    float x[colliderBatch];
+    float y[colliderBatch];
+    float z[colliderBatch];
+
+    void clear() {
+        std::fill(x, x + colliderBatch, std::numeric_limits<float>::quiet_NaN());
+        std::fill(y, y + colliderBatch, std::numeric_limits<float>::quiet_NaN());
+        std::fill(z, z + colliderBatch, std::numeric_limits<float>::quiet_NaN());
+    }
+};
+
+/**
+ * @brief Finds the particles of a batch that are inside a collider. The loops run over a whole batch with neither
+ * branches nor square roots, so that the compiler turns them into vector instructions
+ *
+ * @param collider the collider
+ * @param batch the particles
+ * @param inside receives 1 for every particle that is inside and 0 for the rest
+ * @return the number of particles inside
+ */
+inline int findContacts(const Collider & collider, const ParticleBatch & batch, int inside[colliderBatch]) {
+    const float ax = collider.a.x, ay = collider.a.y, az = collider.a.z;
+    const float bx = collider.b.x, by = collider.b.y, bz = collider.b.z;
+    const float radiusSquared = collider.radius * collider.radius;
+    switch (collider.shape) {
+    case ColliderShape::Plane:
+        for (size_t i = 0; i < colliderBatch; ++i) {
+            inside[i] = (batch.x[i] - ax) * bx + (batch.y[i] - ay) * by + (batch.z[i] - az) * bz < 0.0f;
+        }
+        break;
+    case ColliderShape::Sphere:
+        for (size_t i = 0; i < colliderBatch; ++i) {
+            float dx = batch.x[i] - ax, dy = batch.y[i] - ay, dz = batch.z[i] - az;
+            inside[i] = dx * dx + dy * dy + dz * dz < radiusSquared;
+        }
+        break;
+    case ColliderShape::Capsule: {
+        float ex = bx - ax, ey = by - ay, ez = bz - az;
+        float lengthSquared = ex * ex + ey * ey + ez * ez;
+        float inverse = lengthSquared > 0 ? 1.0f / lengthSquared : 0.0f;
+        for (size_t i = 0; i < colliderBatch; ++i) {
+            float dx = batch.x[i] - ax, dy = batch.y[i] - ay, dz = batch.z[i] - az;
+            float t = (dx * ex + dy * ey + dz * ez) * inverse;
+            // Clamped to [0, 1] through max(t, 0) = (t + |t|) / 2, since a second comparison keeps the loop from vectorizing
+            t = 0.5f * (t + std::fabs(t));
+            t = 1.0f - 0.5f * ((1.0f - t) + std::fabs(1.0f - t));
+            dx -= t * ex;
+            dy -= t * ey;
+            dz -= t * ez;
+            inside[i] = dx * dx + dy * dy + dz * dz < radiusSquared;
+        }
+        break;
+    }
+    case ColliderShape::Box:
+        for (size_t i = 0; i < colliderBatch; ++i) {
+            inside[i] = (std::fabs(batch.x[i] - ax) < bx) & (std::fabs(batch.y[i] - ay) < by) & (std::fabs(batch.z[i] - az) < bz);
+        }
+        break;
+    }
+    int count = 0;
+    for (size_t i = 0; i < colliderBatch; ++i) count += inside[i];
+    return count;
+}
+
+/**
+ * @brief Moves a point that is inside a collider to the nearest point of its surface
+ *
+ * @param collider the collider
+ * @param position the point, which findContacts() found inside
+ * @return the point on the surface
+ */
+inline glm::fvec3 pushOut(const Collider & collider, glm::fvec3 position) {
+    switch (collider.shape) {
+    case ColliderShape::Plane:
+        return position - collider.b * glm::dot(collider.b, position - collider.a);
+    case ColliderShape::Sphere:
+    case ColliderShape::Capsule: {
+        glm::fvec3 centre = collider.a;
+        if (collider.shape == ColliderShape::Capsule) {
+            glm::fvec3 segment = collider.b - collider.a;
+            float lengthSquared = glm::dot(segment, segment);
+            float t = lengthSquared > 0 ? glm::clamp(glm::dot(position - collider.a, segment) / lengthSquared, 0.0f, 1.0f) : 0.0f;
+            centre += segment * t;
+        }
+        glm::fvec3 offset = position - centre;
+        float distance = glm::length(offset);
+        // A particle exactly at the centre goes out the top, since y points down
+        if (distance == 0.0f) return centre - glm::fvec3(0, collider.radius, 0);
+        return centre + offset * (collider.radius / distance);
+    }
+    case ColliderShape::Box: {
+        glm::fvec3 local = position - collider.a;
+        glm::fvec3 depth = collider.b - glm::abs(local);
+        int axis = depth.x < depth.y ? (depth.x < depth.z ? 0 : 2) : (depth.y < depth.z ? 1 : 2);
+        local[axis] = local[axis] < 0 ? -collider.b[axis] : collider.b[axis];
+        return collider.a + local;
+    }
+    }
+    return position;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file constraint_colouring.hpp
+ * @brief Groups constraints into colours whose members share no vertex, so that each colour can be solved in parallel
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "array_store.hpp"
+
+/**
+ * @brief Greedily gives every constraint the lowest colour that no earlier constraint on either of its vertices has,
+ * then stably sorts the constraints by colour. Colouring an array again straight after it was coloured leaves it
+ * unchanged, but once constraints have been removed from their colours the greedy pass may assign different
+ * colours, which is why snapshots store the colour ranges instead of colouring on load
+ *
+ * @param constraints anything with vertex indices a and b, reordered in place
+ * @param vertexCount the number of vertices the constraints refer to
+ * @return the index of the first constraint of every colour, followed by the number of constraints
+ */
+template <typename T>
+std::vector<uint32_t> colourConstraints(ArrayStore<T> & constraints, size_t vertexCount) {
+    // One bit per colour for every vertex, in as many 64 bit words as the busiest vertex needs
+    size_t words = 1;
+    std::vector<uint64_t> used(vertexCount, 0);
+    std::vector<uint32_t> colours(constraints.size());
+    uint32_t colourCount = 0;
+    for (size_t i = 0; i < constraints.size(); ++i) {
+        const T & constraint = constraints[i];
+        uint32_t colour = 0;
+        while (true) {
+            size_t word = colour / 64;
+            if (word == words) {
+                std::vector<uint64_t> wider(vertexCount * (words + 1), 0);
+                for (size_t v = 0; v < vertexCount; ++v) {
+                    for (size_t w = 0; w < words; ++w) wider[v * (words + 1) + w] = used[v * words + w];
+                }
+                used.swap(wider);
+                ++words;
+            }
+            uint64_t taken = used[constraint.a * words + word] | used[constraint.b * words + word];
+            if (~taken == 0) {
+                colour = (word + 1) * 64;
+                continue;
+            }
+            colour = word * 64 + __builtin_ctzll(~taken);
+            break;
+        }
+        used[constraint.a * words + colour / 64] |= 1ull << (colour % 64);
+        used[constraint.b * words + colour / 64] |= 1ull << (colour % 64);
+        colours[i] = colour;
+        colourCount = std::max(colourCount, colour + 1);
+    }
+
+    std::vector<uint32_t> starts(colourCount + 1, 0);
+    for (uint32_t colour : colours) ++starts[colour + 1];
+    for (uint32_t c = 0; c < colourCount; ++c) starts[c + 1] += starts[c];
+
+    bool sorted = true;
+    for (size_t i = 1; i < colours.size() && sorted; ++i) sorted = colours[i - 1] <= colours[i];
+    if (!sorted) {
+        std::vector<T> ordered(constraints.size());
+        std::vector<uint32_t> next(starts.begin(), starts.end() - 1);
+        for (size_t i = 0; i < constraints.size(); ++i) ordered[next[colours[i]]++] = constraints[i];
+        constraints.assign(std::move(ordered));
+    }
+    return starts;
+}
@@ -0,0 +1,203 @@
+/**
+ * @file frame_writer.hpp
+ * @brief Writes rendered frames to disk as PNG or raw PPM images on a background thread
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bounded_queue.hpp"
+#include "trace.hpp"
+
+enum class ImageFormat {
+    PNG,
+    Raw
+};
+
+/*
+A frame read back from OpenGL. The pixels are tightly packed RGB rows stored bottom-up,
+which is the order glReadPixels returns them in.
+*/
+struct Frame {
+    int index = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+/*
+Writes frames to numbered image files. Frames are handed over through a bounded queue so
+that encoding and disk I/O happen on a separate thread while the simulation keeps running.
+*/
+class FrameWriter {
+    std::filesystem::path directory;
+    ImageFormat format;
+    BoundedQueue<Frame> queue;
+    std::thread worker;
+    int failed = 0;
+
+public:
+    FrameWriter(const std::string & directory, ImageFormat format, std::size_t queueDepth = 8)
+        : directory(directory), format(format), queue(queueDepth) {
+        std::error_code error;
+        std::filesystem::create_directories(this->directory, error);
+        worker = std::thread([this] { run(); });
+    }
+
+    ~FrameWriter() {
+        finish();
+    }
+
+    /**
+     * @brief Queues a frame for writing. Waits if the writer has fallen a full queue behind
+     *
+     * @param frame the frame to write
+     */
+    void submit(Frame frame) {
+        queue.push(std::move(frame));
+    }
+
+    // Writes all queued frames and stops the writer thread
+    void finish() {
+        queue.close();
+        if (worker.joinable()) worker.join();
+    }
+
+    int failedFrames() const {
+        return failed;
+    }
+
+private:
+    void run() {
+        Tracer::instance().nameThread("frame writer");
+        Frame frame;
+        while (queue.pop(frame)) {
+            TraceScope scope("write_frame");
+            char name[32];
+            std::snprintf(name, sizeof(name), "frame_%06d.%s", frame.index, format == ImageFormat::PNG ? "png" : "ppm");
+            std::filesystem::path path = directory / name;
+
+            std::ofstream file(path, std::ios::binary);
+            if (file) {
+                if (format == ImageFormat::PNG) writePNG(file, frame);
+                else writePPM(file, frame);
+            }
+            if (!file) {
+                std::cerr << "Failed to write frame " << path << std::endl;
+                ++failed;
+            }
+        }
+    }
+
+    static void writePPM(std::ofstream & file, const Frame & frame) {
+        file << "P6\n" << frame.width << " " << frame.height << "\n255\n";
+        std::size_t stride = static_cast<std::size_t>(frame.width) * 3;
+        for (int y = frame.height - 1; y >= 0; --y) {
+            file.write(reinterpret_cast<const char *>(frame.pixels.data() + y * stride), stride);
+        }
+    }
+
+    /**
+     * @brief Writes the frame as a PNG using uncompressed deflate blocks. Encoding is then a plain copy,
+     * which keeps the writer thread ahead of the simulation without depending on zlib
+     *
+     */
+    static void writePNG(std::ofstream & file, const Frame & frame) {
+        static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        file.write(reinterpret_cast<const char *>(signature), sizeof(signature));
+
+        std::vector<unsigned char> header;
+        appendBigEndian(header, frame.width);
+        appendBigEndian(header, frame.height);
+        header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8 bit depth, RGB, no interlacing
+        writeChunk(file, "IHDR", header);
+
+        // Every scanline starts with filter type 0, rows are flipped to top-down order
+        std::size_t stride = static_cast<std::size_t>(frame.width) * 3;
+        std::vector<unsigned char> raw;
+        raw.reserve((stride + 1) * frame.height);
+        for (int y = frame.height - 1; y >= 0; --y) {
+            raw.push_back(0);
+            raw.insert(raw.end(), frame.pixels.begin() + y * stride, frame.pixels.begin() + (y + 1) * stride);
+        }
+
+        std::vector<unsigned char> zlib;
+        zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+        zlib.push_back(0x78);
+        zlib.push_back(0x01);
+        std::size_t offset = 0;
+        do {
+            std::size_t length = std::min<std::size_t>(raw.size() - offset, 65535);
+            bool last = offset + length == raw.size();
+            zlib.push_back(last ? 1 : 0);
+            zlib.push_back(length & 0xff);
+            zlib.push_back((length >> 8) & 0xff);
+            zlib.push_back(~length & 0xff);
+            zlib.push_back((~length >> 8) & 0xff);
+            zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+            offset += length;
+        } while (offset < raw.size());
+        appendBigEndian(zlib, adler32(raw));
+        writeChunk(file, "IDAT", zlib);
+
+        writeChunk(file, "IEND", {});
+    }
+
+    static void writeChunk(std::ofstream & file, const char * type, const std::vector<unsigned char> & data) {
+        std::vector<unsigned char> length;
+        appendBigEndian(length, static_cast<uint32_t>(data.size()));
+        file.write(reinterpret_cast<const char *>(length.data()), 4);
+        file.write(type, 4);
+        file.write(reinterpret_cast<const char *>(data.data()), data.size());
+
+        uint32_t crc = crc32(0xffffffffu, reinterpret_cast<const unsigned char *>(type), 4);
+        crc = crc32(crc, data.data(), data.size()) ^ 0xffffffffu;
+        std::vector<unsigned char> checksum;
+        appendBigEndian(checksum, crc);
+        file.write(reinterpret_cast<const char *>(checksum.data()), 4);
+    }
+
+    static void appendBigEndian(std::vector<unsigned char> & out, uint32_t value) {
+        out.insert(out.end(), { static_cast<unsigned char>(value >> 24), static_cast<unsigned char>(value >> 16),
+                                static_cast<unsigned char>(value >> 8), static_cast<unsigned char>(value) });
+    }
+
+    static uint32_t crc32(uint32_t crc, const unsigned char * data, std::size_t length) {
+        static const std::vector<uint32_t> table = [] {
+            std::vector<uint32_t> t(256);
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                t[n] = c;
+            }
+            return t;
+        }();
+        for (std::size_t i = 0; i < length; ++i) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        return crc;
+    }
+
+    static uint32_t adler32(const std::vector<unsigned char> & data) {
+        uint32_t a = 1, b = 0;
+        std::size_t i = 0;
+        while (i < data.size()) {
+            // 5552 is the largest block that cannot overflow before taking the modulo
+            std::size_t end = std::min(data.size(), i + 5552);
+            for (; i < end; ++i) {
+                a += data[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        return (b << 16) | a;
+    }
+};
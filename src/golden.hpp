@@ -0,0 +1,84 @@
+/**
+ * @file golden.hpp
+ * @brief Stored state hashes of a canonical scenario that later runs must reproduce bit for bit
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+The hash of the full particle state every few frames of a scenario run at a fixed time step.
+Stored as text:
+
+    dt <seconds>
+    frames <n>
+    every <k>
+    hash <frame> <16 hex digits>
+
+The time step and frame counts are part of the file, so verifying a golden file always repeats
+the run it was written from.
+*/
+struct GoldenHashes {
+    double dt = 0;
+    int frames = 0;
+    int every = 0;
+    std::vector<std::pair<uint32_t, uint64_t>> hashes;
+
+    bool save(const std::string & path) const {
+        std::ofstream file(path, std::ios::trunc);
+        char line[64];
+        file << "# cloth golden hashes v1\n";
+        std::snprintf(line, sizeof(line), "dt %.17g\n", dt);
+        file << line << "frames " << frames << "\nevery " << every << "\n";
+        for (const auto & hash : hashes) {
+            std::snprintf(line, sizeof(line), "hash %u %016llx\n", hash.first, static_cast<unsigned long long>(hash.second));
+            file << line;
+        }
+        if (!file) std::cerr << "Could not write golden hashes " << path << std::endl;
+        return static_cast<bool>(file);
+    }
+
+    bool load(const std::string & path) {
+        std::ifstream file(path);
+        if (!file) {
+            std::cerr << "Could not open golden hashes " << path << std::endl;
+            return false;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            std::istringstream fields(line);
+            std::string kind;
+            fields >> kind;
+            if (kind == "dt") fields >> dt;
+            else if (kind == "frames") fields >> frames;
+            else if (kind == "every") fields >> every;
+            else if (kind == "hash") {
+                uint32_t frame;
+                std::string hex;
+                fields >> frame >> hex;
+                hashes.push_back({ frame, std::strtoull(hex.c_str(), nullptr, 16) });
+            }
+            else fields.setstate(std::ios::failbit);
+            if (!fields) {
+                std::cerr << "Invalid line in golden hashes " << path << ": " << line << std::endl;
+                return false;
+            }
+        }
+        if (dt <= 0 || frames <= 0 || every <= 0) {
+            std::cerr << "Golden hashes " << path << " do not describe a run" << std::endl;
+            return false;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,116 @@
+/**
+ * @file headless.hpp
+ * @brief Creates an offscreen OpenGL context through EGL so the cloth can be rendered without a window
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <cstring>
+#include <iostream>
+
+#if defined(__linux__)
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+/*
+An OpenGL context rendering into a pbuffer. Mesa's surfaceless platform is preferred so that
+no display server is needed, with the default EGL display as a fallback. Both work with the
+software rasterizer on render nodes without a GPU.
+*/
+class HeadlessContext {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+
+public:
+    HeadlessContext() = default;
+    HeadlessContext(const HeadlessContext &) = delete;
+    HeadlessContext & operator=(const HeadlessContext &) = delete;
+
+    ~HeadlessContext() {
+        if (display == EGL_NO_DISPLAY) return;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+        if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+        eglTerminate(display);
+    }
+
+    /**
+     * @brief Creates the context and makes it current on the calling thread
+     *
+     * @param width the width of the offscreen framebuffer in pixels
+     * @param height the height of the offscreen framebuffer in pixels
+     * @return false if no EGL display or OpenGL context could be created
+     */
+    bool create(int width, int height) {
+        const char * extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (extensions && std::strstr(extensions, "EGL_MESA_platform_surfaceless") && getPlatformDisplay) {
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+                std::cerr << "Could not initialize an EGL display" << std::endl;
+                display = EGL_NO_DISPLAY;
+                return false;
+            }
+        }
+
+        const EGLint configAttributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_BLUE_SIZE, 8,
+            EGL_DEPTH_SIZE, 24,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+            std::cerr << "No EGL config supports offscreen OpenGL rendering" << std::endl;
+            return false;
+        }
+
+        const EGLint surfaceAttributes[] = {
+            EGL_WIDTH, width,
+            EGL_HEIGHT, height,
+            EGL_NONE
+        };
+        surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+        if (surface == EGL_NO_SURFACE) {
+            std::cerr << "Failed to create EGL pbuffer surface" << std::endl;
+            return false;
+        }
+
+        // The cloth is drawn with the fixed function pipeline, so ask for a compatibility context
+        eglBindAPI(EGL_OPENGL_API);
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+        if (context == EGL_NO_CONTEXT) {
+            std::cerr << "Failed to create EGL OpenGL context" << std::endl;
+            return false;
+        }
+
+        if (!eglMakeCurrent(display, surface, surface, context)) {
+            std::cerr << "Failed to make EGL context current" << std::endl;
+            return false;
+        }
+        return true;
+    }
+};
+
+#else
+
+// EGL is only used on Linux, other platforms report that headless rendering is unavailable
+class HeadlessContext {
+public:
+    bool create(int width, int height) {
+        std::cerr << "Headless rendering is only supported on Linux" << std::endl;
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,169 @@
+/**
+ * @file input_log.hpp
+ * @brief Records mouse input stamped with simulation steps and replays it deterministically
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+enum class InputEventType {
+    CursorMove,
+    ButtonPress,
+    ButtonRelease,
+    // Not an input event, marks that a step was simulated with the time step dt
+    Step
+};
+
+/*
+A mouse event, or a simulated step, together with the number of steps simulated before it happened
+*/
+struct InputEvent {
+    uint32_t step = 0;
+    InputEventType type = InputEventType::CursorMove;
+    int button = 0;
+    double x = 0;
+    double y = 0;
+    double dt = 0;
+};
+
+/*
+Writes input events to a text file with one event per line:
+
+    move <step> <x> <y>
+    press <step> <button> <x> <y>
+    release <step> <button> <x> <y>
+    step <step> <dt>
+
+Numbers are written with enough digits to be read back exactly, so a replay feeds the
+simulation the very same values as the recorded session.
+*/
+class InputRecorder {
+    std::ofstream file;
+
+public:
+    explicit InputRecorder(const std::string & path) : file(path, std::ios::trunc) {
+        if (!file) std::cerr << "Could not open input recording " << path << std::endl;
+        file << "# cloth input v1\n";
+    }
+
+    bool isOpen() const {
+        return static_cast<bool>(file);
+    }
+
+    void record(const InputEvent & event) {
+        char line[128];
+        switch (event.type) {
+        case InputEventType::CursorMove:
+            std::snprintf(line, sizeof(line), "move %u %.17g %.17g\n", event.step, event.x, event.y);
+            break;
+        case InputEventType::ButtonPress:
+        case InputEventType::ButtonRelease:
+            std::snprintf(line, sizeof(line), "%s %u %d %.17g %.17g\n", event.type == InputEventType::ButtonPress ? "press" : "release",
+                          event.step, event.button, event.x, event.y);
+            break;
+        case InputEventType::Step:
+            std::snprintf(line, sizeof(line), "step %u %.17g\n", event.step, event.dt);
+            break;
+        }
+        file << line;
+    }
+};
+
+/*
+Holds a recorded input file and hands out its events in order as the simulation reaches their steps
+*/
+class InputReplay {
+    std::vector<InputEvent> events;
+    size_t next = 0;
+
+public:
+    /**
+     * @brief Reads a file written by InputRecorder
+     *
+     * @return false if the file cannot be read or contains an unknown line
+     */
+    bool load(const std::string & path) {
+        std::ifstream file(path);
+        if (!file) {
+            std::cerr << "Could not open input recording " << path << std::endl;
+            return false;
+        }
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(file, line)) {
+            ++lineNumber;
+            if (line.empty() || line[0] == '#') continue;
+            std::istringstream fields(line);
+            std::string kind;
+            InputEvent event;
+            fields >> kind >> event.step;
+            if (kind == "move") {
+                event.type = InputEventType::CursorMove;
+                fields >> event.x >> event.y;
+            }
+            else if (kind == "press" || kind == "release") {
+                event.type = kind == "press" ? InputEventType::ButtonPress : InputEventType::ButtonRelease;
+                fields >> event.button >> event.x >> event.y;
+            }
+            else if (kind == "step") {
+                event.type = InputEventType::Step;
+                fields >> event.dt;
+            }
+            else {
+                fields.setstate(std::ios::failbit);
+            }
+            if (!fields) {
+                std::cerr << "Invalid input event on line " << lineNumber << " of " << path << std::endl;
+                return false;
+            }
+            events.push_back(event);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Returns the next event if it happened at or before the given step
+     *
+     * @param step the number of steps simulated so far
+     * @param event receives the event
+     * @return false if the next event belongs to a later step or the replay has ended
+     */
+    bool poll(uint32_t step, InputEvent & event) {
+        if (next >= events.size() || events[next].step > step) return false;
+        event = events[next++];
+        return true;
+    }
+
+    bool finished() const {
+        return next >= events.size();
+    }
+
+    // Whether the next event belongs to a step after the given one
+    bool waitingFor(uint32_t step) const {
+        return next < events.size() && events[next].step > step;
+    }
+
+    // The index of the next event to be handed out, which seek() accepts to continue from the same point
+    size_t position() const {
+        return next;
+    }
+
+    /**
+     * @brief Continues the replay from the given event, for example after resuming from a checkpoint
+     *
+     * @return false if the replay has fewer events
+     */
+    bool seek(size_t event) {
+        if (event > events.size()) return false;
+        next = event;
+        return true;
+    }
+};
@@ -8,8 +8,38 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <numeric>
+#include <thread>
+// Buffer objects are part of OpenGL 1.5, which is only declared by glext.h
+#define GL_GLEXT_PROTOTYPES
+#define GLFW_INCLUDE_GLEXT
 #include <GLFW/glfw3.h>
 #include <glm.hpp>
+#include "array_store.hpp"
+#include "asset_cache.hpp"
+#include "colliders.hpp"
+#include "benchmark.hpp"
+#include "constraint_colouring.hpp"
+#include "frame_writer.hpp"
+#include "golden.hpp"
+#include "headless.hpp"
+#include "input_log.hpp"
+#include "mesh_loader.hpp"
+#include "particle_handles.hpp"
+#include "profiler.hpp"
+#include "recorder.hpp"
+#include "snapshot.hpp"
+#include "spatial_hash.hpp"
+#include "thread_pool.hpp"
 
 /*
 Class representing a vertex in the cloth and its properties
@@ -28,312 +58,2803 @@ public:
     }
 };
 
+/*
+A distance constraint between two vertices. Vertex a is the one that is moved when b is fixed
+*/
+struct Constraint {
+    uint32_t a;
+    uint32_t b;
+    float restLength;
+};
+
+/*
+Parameters of the Verlet integration and the Jakobsen method
+*/
+struct SolverParams {
+    // Fraction of the velocity that is lost every step
+    float drag = 0.02f;
+    // The number of times the Jakobsen method is run per step
+    int iterations = 2;
+    // A constraint breaks when it is stretched to more than this many times its rest length
+    float breakingLimit = 20;
+    // Fraction of the violation of a bending constraint that is corrected per iteration
+    float bendingStiffness = 0.1f;
+};
+
 /*
 Class representing a cloth and implements Verlet integration and the Jakobsen method
 */
 class Cloth {
-    using ClothMat = std::vector<std::vector<Vertex>>;
-    
-    ClothMat vertices;
-    float segmentLength;
-    int rows;
-    int cols;
-    Vertex * grabbedVertex = nullptr;
+    // Vertices of a grid are stored row-major, vertex (r, c) is at index r * cols + c. Vertices that
+    // tearing splits off are appended after the grid.
+    // A cloth built from a mesh has no rows or columns and is drawn along its constraints
+    ArrayStore<Vertex> vertices;
+    ArrayStore<Constraint> constraints;
+    // Soft constraints across the shared edge of two triangles that resist folding, they never break
+    ArrayStore<Constraint> bendingConstraints;
+    // Both kinds of constraints are sorted by colour, constraints of one colour share no vertex.
+    // Colour c spans indices [colours[c], colours[c + 1])
+    std::vector<uint32_t> constraintColours;
+    std::vector<uint32_t> bendingColours;
+    // The constraints at every vertex, bending constraints are marked with bendingFlag. The entries of
+    // vertex v are adjacency[adjacencyStart[v]] onwards, adjacencyCount[v] of them. Tearing only ever
+    // removes entries from a range, a vertex that is split off gets a new range at the end
+    static const uint32_t bendingFlag = 1u << 31;
+    ArrayStore<uint32_t> adjacency;
+    ArrayStore<uint32_t> adjacencyStart;
+    ArrayStore<uint32_t> adjacencyCount;
+    SolverParams params;
+    float segmentLength = 0;
+    int rows = 0;
+    int cols = 0;
+    // The vertex at grid position r * cols + c once the grid has been compacted, UINT32_MAX if compaction removed it.
+    // Empty before the first compaction
+    std::vector<uint32_t> gridVertices;
+    // Interaction code refers to particles through handles, which follow them when the storage is compacted
+    ParticleHandles handles;
+    ParticleHandle grabbed;
+    // Particles pulled towards a target by stiffness times their distance to it in every iteration of the solver,
+    // at most one per particle. The mouse grab is one of them, with grabStiffness
+    struct Attachment {
+        ParticleHandle particle;
+        glm::fvec3 target;
+        float stiffness;
+    };
+    std::vector<Attachment> attachments;
+    float grabStiffness = 0.5f;
+    // Grabbing and the brush look for vertices within pickRadius of the mouse in the spatial index,
+    // which holds the positions of live vertices and is rebuilt at most once per step, when it is needed
+    float pickRadius = 10.0f;
+    SpatialHash spatialIndex;
+    bool spatialIndexStale = true;
+    // Static shapes that particles are pushed out of once per step, after the constraints. Each tile of
+    // vertices is only tested against the colliders that overlap its bounding box
+    std::vector<Collider> colliders;
+    // Triangle meshes, possibly moving, that the path of every particle over a step is tested against
+    std::vector<MeshCollider> meshColliders;
+    static const size_t collisionTileChunk = 16;
+    // Destroyed vertices are skipped by every loop until compact() removes them, which happens once
+    // they make up a quarter of the cloth and number at least compactionMinimum
+    size_t destroyedVertices = 0;
+    static const size_t compactionMinimum = 256;
+
+    // The connected parts of the cloth. Every live vertex belongs to one fragment, which is kept up to date
+    // as tearing and the brush cut the cloth apart. Every fragmentCheckInterval steps, fragments that have
+    // settled are put to sleep on their own, and fragments without a fixed vertex that have fallen below
+    // cullHeight are destroyed, since nothing can bring them back. Every fragment lists its vertices, so
+    // waking or culling one costs time in proportion to its size rather than to the whole cloth
+    struct Fragment {
+        std::vector<uint32_t> members;
+        uint32_t fixed = 0;
+        uint32_t quietChecks = 0;
+        bool asleep = false;
+    };
+    std::vector<Fragment> fragments;
+    std::vector<uint32_t> fragmentOf;
+    // The position of every vertex in the member list of its fragment
+    std::vector<uint32_t> memberIndex;
+    // 1 for the vertices of sleeping fragments, which the solver skips
+    std::vector<uint8_t> sleepingVertices;
+    static const uint32_t fragmentCheckInterval = 10;
+    float cullHeight = std::numeric_limits<float>::max();
+    std::vector<float> fragmentMotion;
+    std::vector<float> fragmentTop;
+    // Scratch space of the searches that find out whether a cut separated the cloth
+    std::vector<uint32_t> searchMark;
+    uint32_t searchStamp = 0;
+    std::vector<uint32_t> searchA;
+    std::vector<uint32_t> searchB;
     glm::fvec3 mousePosition;
     bool rightMousePressed = false;
-    float timeSinceLastMouse = 0.0f;
+    double timeSinceLastMouse = 0.0;
+
+    // Vertices are grouped into tiles of consecutive row-major indices. Only tiles that moved
+    // more than dirtyEpsilon since they were last uploaded are sent to the GPU again
+    static const int tileSize = 256;
+    float dirtyEpsilon = 0.01f;
+    std::vector<glm::fvec3> uploadedPositions;
+    std::vector<unsigned char> dirtyTiles;
+
+    GLuint vertexBuffer = 0;
+    GLuint indexBuffer = 0;
+    // The vertex buffer has room to spare, so vertices split off by tearing do not force a full upload
+    size_t vertexBufferCapacity = 0;
+    GLsizei indexCount = 0;
+    bool topologyChanged = true;
+    // At full resolution the index buffer holds one line per constraint, in constraint order. Tearing
+    // only rewrites the lines of the constraints it moved or changed
+    bool linePerConstraint = false;
+    std::vector<uint32_t> changedLines;
+
+    // Level of detail: when neighbouring vertices are closer than lodMinSpacing pixels on screen,
+    // only every lodStride-th row and column is drawn. Blocks of lodStride x lodStride vertices
+    // around tears and the grabbed vertex are still drawn at full resolution
+    float lodMinSpacing = 2.0f;
+    int lodStride = 1;
+    int lodFocus = -1;
+
+    // The cloth falls asleep once no visible vertex has moved more than sleepThreshold per step
+    // for stepsToSleep consecutive steps, and stays asleep until it is woken up by input
+    float sleepThreshold = 0.01f;
+    int stepsToSleep = 60;
+    int quietSteps = 0;
+    bool asleep = false;
+
+    // The number of steps simulated since the cloth was created and the simulated time they covered
+    uint32_t step = 0;
+    double simulationTime = 0.0;
+
+    // The solver splits its loops into chunks of a fixed size, whatever the number of threads, and
+    // combines the results of the chunks in chunk order. Each chunk's result lands in its own slot
+    static const size_t vertexChunk = 4096;
+    static const size_t constraintChunk = 4096;
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<float> chunkMotion;
+    std::vector<std::vector<uint32_t>> chunkTears;
+    // Constraints stretched past the breaking limit at the end of a step, in constraint order
+    std::vector<uint32_t> breakQueue;
+    // While the queue is applied, the position in breakQueue of every queued constraint and UINT32_MAX for the others.
+    // Removing a constraint moves others to new indices, which are followed here so that no queued break is lost
+    std::vector<uint32_t> breakSlot;
 
 public:
+    // Creates an empty cloth, to be filled by loadSnapshot()
+    Cloth() = default;
+
     Cloth(glm::fvec3 start, float segmentLength, int rows, int cols)
         : segmentLength(segmentLength), rows(rows), cols(cols) {
         
         // Initialize vertices based on number of rows and columns
+        std::vector<Vertex> grid;
+        grid.reserve(rows * cols);
         for (int r = 0; r < rows; ++r) {
             bool fixed = r == 0;
-            std::vector<Vertex> tmp;
             for (int c = 0; c < cols; ++c) {
                 glm::fvec3 pos = start + glm::fvec3(segmentLength * c, segmentLength * r, 0);
                 glm::fvec3 acc = glm::fvec3(0, 981.0f, 0);
                 float mass = 2.0f;
-                tmp.push_back(Vertex(pos.x, pos.y, pos.z, acc, fixed, mass));
+                grid.push_back(Vertex(pos.x, pos.y, pos.z, acc, fixed, mass));
+            }
+        }
+        vertices.assign(std::move(grid));
+
+        // Every vertex is constrained to its left and upper neighbour, in the order the grid is swept.
+        // Colouring keeps that order within each colour
+        std::vector<Constraint> links;
+        links.reserve(2 * rows * cols);
+        for (int r = 0; r < rows; ++r) {
+            for (int c = 0; c < cols; ++c) {
+                uint32_t i = r * cols + c;
+                if (c > 0) links.push_back(Constraint{ i, i - 1, segmentLength });
+                if (r > 0) links.push_back(Constraint{ i, i - cols, segmentLength });
             }
-            vertices.push_back(tmp);
         }
+        constraints.assign(std::move(links));
+
+        colourAllConstraints();
+        resetRenderState();
     }
 
-    void releaseLeftMouseButton() {
-        rightMousePressed = false;
+    /**
+     * @brief Creates a cloth from a triangle mesh. Every edge becomes a constraint at its current length
+     * 
+     * @param mesh the mesh, already placed in world space
+     * @param pinBand vertices within this distance of the top of the mesh are fixed
+     */
+    Cloth(const MeshData & mesh, float pinBand) {
+        float top = mesh.positions.empty() ? 0.0f : mesh.positions[0].y;
+        for (const glm::fvec3 & position : mesh.positions) top = std::min(top, position.y);
+
+        std::vector<Vertex> points;
+        points.reserve(mesh.positions.size());
+        for (const glm::fvec3 & position : mesh.positions) {
+            points.push_back(Vertex(position.x, position.y, position.z, glm::fvec3(0, 981.0f, 0), position.y <= top + pinBand, 2.0f));
+        }
+        vertices.assign(std::move(points));
+
+        MeshTopology topology = extractTopology(mesh);
+        auto link = [&](const std::pair<uint32_t, uint32_t> & edge) {
+            return Constraint{ edge.first, edge.second, glm::length(mesh.positions[edge.first] - mesh.positions[edge.second]) };
+        };
+        std::vector<Constraint> links;
+        links.reserve(topology.edges.size());
+        for (const auto & edge : topology.edges) {
+            links.push_back(link(edge));
+            segmentLength += links.back().restLength;
+        }
+        segmentLength /= std::max<size_t>(links.size(), 1);
+        constraints.assign(std::move(links));
+
+        std::vector<Constraint> bending;
+        bending.reserve(topology.bendingPairs.size());
+        for (const auto & pair : topology.bendingPairs) bending.push_back(link(pair));
+        bendingConstraints.assign(std::move(bending));
+
+        colourAllConstraints();
+        resetRenderState();
     }
 
-    void pressRightMouseButton(double x, double y) {
-        rightMousePressed = true;
+    bool isGrid() const {
+        return rows > 0 && cols > 0;
     }
 
-    void releasePoint() {
-        grabbedVertex = nullptr;
+    // The vertex at a grid position, UINT32_MAX if compaction removed it
+    uint32_t gridVertex(int r, int c) const {
+        uint32_t position = r * cols + c;
+        return gridVertices.empty() ? position : gridVertices[position];
     }
-    
-    bool isGrabbingPoint() {
-        return grabbedVertex != nullptr;
+
+    // The number of grid vertices, which are stored before the vertices split off by tearing
+    uint32_t gridVertexCount() const {
+        if (gridVertices.empty()) return rows * cols;
+        for (size_t position = gridVertices.size(); position-- > 0;) {
+            if (gridVertices[position] != UINT32_MAX) return gridVertices[position] + 1;
+        }
+        return 0;
+    }
+
+    // Colliders are set up before the first step. The cloth is not woken, so a cloth resumed asleep from a checkpoint stays asleep
+    void setColliders(std::vector<Collider> shapes, std::vector<MeshCollider> meshes) {
+        colliders = std::move(shapes);
+        meshColliders = std::move(meshes);
+    }
+
+    // Fragments without a fixed vertex are culled once they have fallen entirely below this height
+    void setCullHeight(float height) {
+        cullHeight = height;
     }
 
     /**
-     * @brief Sets the mouse position and destroys vertices close to it if the right mouse button is pressed
+     * @brief Sets the number of threads the solver runs on. The results are the same for every thread count
      * 
-     * 
-     * @param x 
-     * @param y 
+     * @param threads the number of threads including the calling one, 1 solves on the calling thread only
      */
-    void setMousePosition(double x, double y) {
-        mousePosition = glm::fvec3(x, y, 0);
-        if (grabbedVertex != nullptr) mousePosition.z = grabbedVertex->pos.z;
+    void setSolverThreads(int threads) {
+        if (threads <= 1) pool.reset();
+        else if (!pool || pool->threadCount() != threads) pool.reset(new ThreadPool(threads));
+    }
 
-        // Only destroy vertices if right mouse button is pressed and only 60 times per second
-        if (!rightMousePressed || glfwGetTime() - timeSinceLastMouse < 1 / 60.0f) return;
-        timeSinceLastMouse = glfwGetTime();
+    /**
+     * @brief Sorts the constraints by colour, which decides the order they are solved in, indexes them by vertex and finds the fragments
+     * 
+     * @param fragmentState the state of the fragment of every vertex as stored in checkpoints, or nullptr
+     */
+    void colourAllConstraints(const uint8_t * fragmentState = nullptr) {
+        constraintColours = colourConstraints(constraints, vertices.size());
+        bendingColours = colourConstraints(bendingConstraints, vertices.size());
+        buildAdjacency();
+        destroyedVertices = 0;
+        for (const Vertex & vertex : vertices) destroyedVertices += vertex.destroyed;
+        buildFragments(fragmentState);
+    }
 
-        double threshold = 10;
-        // If a vertex is close enough to the mouse position, destroy it
-        for (int r = 0; r < rows; ++r) {
-            for (int c = 0; c < cols; ++c) {
-                double distance = glm::length(vertices[r][c].pos - glm::fvec3(x, y, vertices[r][c].pos.z));
-                if (distance < threshold) {
-                    vertices[r][c].destroyed = true;
-                }
+    void buildAdjacency() {
+        std::vector<uint32_t> count(vertices.size(), 0);
+        for (const ArrayStore<Constraint> * store : { &constraints, &bendingConstraints }) {
+            for (const Constraint & constraint : *store) {
+                ++count[constraint.a];
+                ++count[constraint.b];
             }
         }
+        std::vector<uint32_t> start(vertices.size(), 0);
+        for (size_t v = 1; v < vertices.size(); ++v) start[v] = start[v - 1] + count[v - 1];
+        std::vector<uint32_t> entries(2 * (constraints.size() + bendingConstraints.size()), 0);
+        std::fill(count.begin(), count.end(), 0);
+        for (uint32_t i = 0; i < constraints.size(); ++i) {
+            entries[start[constraints[i].a] + count[constraints[i].a]++] = i;
+            entries[start[constraints[i].b] + count[constraints[i].b]++] = i;
+        }
+        for (uint32_t i = 0; i < bendingConstraints.size(); ++i) {
+            entries[start[bendingConstraints[i].a] + count[bendingConstraints[i].a]++] = i | bendingFlag;
+            entries[start[bendingConstraints[i].b] + count[bendingConstraints[i].b]++] = i | bendingFlag;
+        }
+        adjacency.assign(std::move(entries));
+        adjacencyStart.assign(std::move(start));
+        adjacencyCount.assign(std::move(count));
     }
-    
+
+    // Calls f(other) for every live vertex that shares a constraint or bending constraint with the vertex
+    template <typename F>
+    void forEachNeighbour(uint32_t vertex, F && f) const {
+        for (uint32_t e = adjacencyStart[vertex]; e < adjacencyStart[vertex] + adjacencyCount[vertex]; ++e) {
+            uint32_t entry = adjacency[e];
+            const Constraint & constraint = entry & bendingFlag ? bendingConstraints[entry & ~bendingFlag] : constraints[entry];
+            uint32_t other = constraint.a == vertex ? constraint.b : constraint.a;
+            if (!vertices[other].destroyed) f(other);
+        }
+    }
+
     /**
-     * @brief Grabs a point if the mouse is close enough to it
+     * @brief Labels the fragments with a breadth-first search over all live vertices
      * 
-     * @param x the x-coordinate of the mouse in screen space
-     * @param y the y-coordinate of the mouse in screen space
+     * @param state the state of the fragment of every vertex as stored in checkpoints, or nullptr to start all fragments awake
      */
-    void grabPoint(double x, double y) {
-        double threshold = 10;
-        if (grabbedVertex == nullptr) {
-            for (int r = 0; r < rows; ++r) {
-                for (int c = 0; c < cols; ++c) {
-                    double distance = glm::length(vertices[r][c].pos - glm::fvec3(x, y, vertices[r][c].pos.z));
-                    if (distance < threshold) {
-                        grabbedVertex = &vertices[r][c];
-                        mousePosition = glm::fvec3(x, y, vertices[r][c].pos.z);
-                        return;
-                    }
-                }
+    void buildFragments(const uint8_t * state) {
+        fragments.clear();
+        fragmentOf.assign(vertices.size(), UINT32_MAX);
+        memberIndex.assign(vertices.size(), UINT32_MAX);
+        sleepingVertices.assign(vertices.size(), 0);
+        std::vector<uint32_t> queue;
+        for (uint32_t seed = 0; seed < vertices.size(); ++seed) {
+            if (vertices[seed].destroyed || fragmentOf[seed] != UINT32_MAX) continue;
+            uint32_t fragment = fragments.size();
+            fragments.push_back(Fragment());
+            if (state) {
+                fragments.back().asleep = state[seed] >> 7;
+                fragments.back().quietChecks = state[seed] & 0x7f;
+            }
+            queue.assign(1, seed);
+            fragmentOf[seed] = fragment;
+            for (size_t head = 0; head < queue.size(); ++head) {
+                uint32_t vertex = queue[head];
+                memberIndex[vertex] = head;
+                fragments.back().fixed += vertices[vertex].fixed;
+                sleepingVertices[vertex] = fragments.back().asleep;
+                forEachNeighbour(vertex, [&](uint32_t other) {
+                    if (fragmentOf[other] != UINT32_MAX) return;
+                    fragmentOf[other] = fragment;
+                    queue.push_back(other);
+                });
             }
+            // The queue holds every vertex of the fragment in the order memberIndex was given out
+            fragments.back().members = queue;
         }
     }
-    
+
+    // The fragment of every vertex in the form snapshots store it, with the fragments that still have members numbered from 0
+    std::vector<uint32_t> fragmentLabels() const {
+        std::vector<uint32_t> number(fragments.size(), UINT32_MAX);
+        uint32_t next = 0;
+        for (size_t f = 0; f < fragments.size(); ++f) {
+            if (!fragments[f].members.empty()) number[f] = next++;
+        }
+        std::vector<uint32_t> labels(vertices.size(), UINT32_MAX);
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            if (fragmentOf[i] != UINT32_MAX) labels[i] = number[fragmentOf[i]];
+        }
+        return labels;
+    }
+
     /**
-     * @brief Updates the cloth by applying Verlet integration and the Jakobsen method to all vertices
+     * @brief Restores the fragments from the labels a snapshot stores, which takes one pass over the vertices
+     * instead of a search along the constraints
      * 
-     * @param dt the time since the last update
+     * @param labels the fragment of every vertex, from fragmentLabels()
+     * @param state the state of the fragment of every vertex as stored in checkpoints, or nullptr to start all fragments awake
      */
-    void update(float dt) {
-        float drag = 0.02;
-        // Apply verlet integration to all vertices except the fixed ones
-        for (int r = 0; r < rows; ++r) {
-            for (int c = 0; c < cols; ++c) {
-                if (vertices[r][c].fixed) continue;
-                
-                // Implementation of Verlet integration
-                Vertex v = vertices[r][c];
-                glm::fvec3 copy = glm::fvec3(v.pos);
-                vertices[r][c].pos = v.pos + (1.0f - drag) * (v.pos - v.prevPos) + dt * dt* v.mass*v.acceleration;
-                vertices[r][c].prevPos = copy;
+    void loadFragments(const uint32_t * labels, const uint8_t * state) {
+        fragments.clear();
+        fragmentOf.assign(vertices.size(), UINT32_MAX);
+        memberIndex.assign(vertices.size(), UINT32_MAX);
+        sleepingVertices.assign(vertices.size(), 0);
+        for (uint32_t i = 0; i < vertices.size(); ++i) {
+            if (labels[i] == UINT32_MAX) continue;
+            if (labels[i] >= fragments.size()) fragments.resize(labels[i] + 1);
+            Fragment & fragment = fragments[labels[i]];
+            if (state && fragment.members.empty()) {
+                fragment.asleep = state[i] >> 7;
+                fragment.quietChecks = state[i] & 0x7f;
             }
+            addToFragment(i, labels[i]);
+            sleepingVertices[i] = fragment.asleep;
         }
+    }
 
-        // If a vertex is currently grabbed, set its position to the mouse position
-        if (grabbedVertex != nullptr) {
-            grabbedVertex->pos = mousePosition;
-        }
-        
-        // The numer of times the Jakobsen method is run
-        int iterations = 2;
-        for (int i = 0; i < iterations; ++i) {
-            satisfyConstraints();
+    // The state of every vertex's fragment in the form checkpoints store it
+    std::vector<uint8_t> fragmentState() const {
+        std::vector<uint8_t> state(vertices.size(), 0);
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            if (fragmentOf[i] == UINT32_MAX) continue;
+            const Fragment & fragment = fragments[fragmentOf[i]];
+            state[i] = (fragment.asleep ? 0x80 : 0) | std::min<uint32_t>(fragment.quietChecks, 0x7f);
         }
+        return state;
     }
 
     /**
-     * @brief Applies the Jakobsen method to all vertices by checking the distance between vertices and moving them accordingly
+     * @brief Finds out whether two vertices of the same fragment are still connected. Searches from both
+     * in turn, so when they are not, the search that runs out first has found the smaller part, which is
+     * moved to a new fragment. The cost is proportional to the size of that part
      * 
+     * @return true if the vertices are connected
      */
-    void satisfyConstraints() {
-
-        int breakingLimit = 20;
-        for (int r = 0; r < rows; ++r) {
-            for (int c = 0; c < cols; ++c) {
-                if (vertices[r][c].fixed || vertices[r][c].destroyed) continue;
-                
-                // Check constraint against vertex to the left
-                if (c > 0 && !vertices[r][c-1].destroyed) {
-                    glm::vec3 delta = (vertices[r][c].pos - vertices[r][c-1].pos);
-                    float distance = glm::length(delta);
-                    float tmp = distance / segmentLength;
+    bool stillConnected(uint32_t u, uint32_t v) {
+        if (u == v) return true;
+        searchMark.resize(vertices.size(), 0);
+        if (searchStamp > UINT32_MAX - 2) {
+            std::fill(searchMark.begin(), searchMark.end(), 0);
+            searchStamp = 0;
+        }
+        uint32_t markU = ++searchStamp;
+        uint32_t markV = ++searchStamp;
+        searchA.assign(1, u);
+        searchB.assign(1, v);
+        searchMark[u] = markU;
+        searchMark[v] = markV;
+        size_t headA = 0;
+        size_t headB = 0;
+        while (true) {
+            for (int side = 0; side < 2; ++side) {
+                std::vector<uint32_t> & queue = side == 0 ? searchA : searchB;
+                size_t & head = side == 0 ? headA : headB;
+                uint32_t own = side == 0 ? markU : markV;
+                uint32_t other = side == 0 ? markV : markU;
+                if (head == queue.size()) {
+                    moveToNewFragment(queue);
+                    return false;
+                }
+                bool met = false;
+                forEachNeighbour(queue[head++], [&](uint32_t next) {
+                    if (searchMark[next] == other) met = true;
+                    if (met || searchMark[next] == own) return;
+                    searchMark[next] = own;
+                    queue.push_back(next);
+                });
+                if (met) return true;
+            }
+        }
+    }
 
-                    // If the distance between two vertices is too large while no vertex is grabbed, destroy the concerned vertices
-                    if (tmp > breakingLimit && grabbedVertex == nullptr) {
-                        vertices[r][c].destroyed = true; vertices[r][c - 1].destroyed = true;
-                        return;
-                    }
+    // Adds a vertex that belongs to no fragment to the end of a fragment's member list
+    void addToFragment(uint32_t vertex, uint32_t fragment) {
+        fragmentOf[vertex] = fragment;
+        memberIndex[vertex] = fragments[fragment].members.size();
+        fragments[fragment].members.push_back(vertex);
+        fragments[fragment].fixed += vertices[vertex].fixed;
+    }
 
-                    float difference = (distance - segmentLength) / distance;
-                    // If the vertex to the left is fixed, the current vertex is moved the whole distance
-                    // Otherwise, the distance is split between the two vertices
-                    if (vertices[r][c - 1].fixed) {
-                        vertices[r][c].pos -= delta * difference * 1.0f; 
-                    }
-                    else {
-                        vertices[r][c].pos -= delta * difference * 0.5f;
-                        vertices[r][c - 1].pos += delta * difference * 0.5f;
-                    }
-                }
+    // Takes a vertex out of its fragment, filling its place in the member list with the last member
+    void removeFromFragment(uint32_t vertex) {
+        Fragment & fragment = fragments[fragmentOf[vertex]];
+        uint32_t last = fragment.members.back();
+        fragment.members[memberIndex[vertex]] = last;
+        memberIndex[last] = memberIndex[vertex];
+        fragment.members.pop_back();
+        fragment.fixed -= vertices[vertex].fixed;
+        fragmentOf[vertex] = UINT32_MAX;
+        memberIndex[vertex] = UINT32_MAX;
+    }
 
-                // Check constraint against vertex above
-                if (r > 0 && !vertices[r - 1][c].destroyed) {
-                    glm::vec3 delta = (vertices[r][c].pos - vertices[r - 1][c].pos);
-                    float distance = glm::length(delta);
-                    float tmp = distance / segmentLength;
+    // Moves vertices that have been cut off from the rest of their fragment to a fragment of their own
+    void moveToNewFragment(const std::vector<uint32_t> & part) {
+        uint32_t fragment = fragments.size();
+        const Fragment & previous = fragments[fragmentOf[part[0]]];
+        Fragment split;
+        split.quietChecks = previous.quietChecks;
+        split.asleep = previous.asleep;
+        fragments.push_back(std::move(split));
+        for (uint32_t vertex : part) {
+            removeFromFragment(vertex);
+            addToFragment(vertex, fragment);
+        }
+    }
 
-                    if (tmp > breakingLimit && grabbedVertex == nullptr) {
-                        vertices[r][c].destroyed = true; vertices[r - 1][c].destroyed = true;
-                        return;
-                    }
-                    
-                    float difference = (distance - segmentLength) / distance;
-                    
-                    if (vertices[r - 1][c].fixed) {
-                        vertices[r][c].pos -= delta * difference * 1.0f;
-                    }
-                    else {
-                        vertices[r][c].pos -= delta * difference * 0.5f;
-                        vertices[r-1][c].pos += delta * difference * 0.5f;
-                    }
+    /**
+     * @brief Updates the fragments after a cut. The vertices next to the cut are compared with each other, and
+     * every one that is no longer connected to the others ends up in a fragment of its own
+     * 
+     * @param seeds the live vertices on either side of the cut
+     */
+    void separateFragments(const std::vector<uint32_t> & seeds) {
+        std::vector<uint32_t> representatives;
+        for (uint32_t seed : seeds) {
+            if (vertices[seed].destroyed) continue;
+            bool found = false;
+            for (uint32_t representative : representatives) {
+                if (fragmentOf[representative] == fragmentOf[seed] && stillConnected(representative, seed)) {
+                    found = true;
+                    break;
                 }
             }
+            if (!found) representatives.push_back(seed);
         }
     }
 
-    // Draw all lines between the vertices
-    void draw(GLFWwindow * window) {
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // Wakes or sends to sleep every vertex of a fragment
+    void setFragmentAsleep(uint32_t fragment, bool sleep) {
+        if (fragments[fragment].asleep == sleep) return;
+        fragments[fragment].asleep = sleep;
+        fragments[fragment].quietChecks = 0;
+        for (uint32_t vertex : fragments[fragment].members) sleepingVertices[vertex] = sleep;
+    }
 
-        for (int r = 0; r < rows; ++r) {
-            glBegin(GL_LINE_STRIP);
-            for (int c = 0; c < cols; ++c) {
-                // If a vertex is destroyed, start a new line strip and skip the current vertex
-                if (vertices[r][c].destroyed) {
-                    glEnd();
-                    glBegin(GL_LINE_STRIP);
-                    continue;
-                }
-                glm::fvec3 pos = vertices[r][c].pos;
-                glVertex3f(pos.x, pos.y, pos.z);
+    void updateSpatialIndex() {
+        if (!spatialIndexStale) return;
+        spatialIndex.build(vertices.size(), pickRadius, [&](size_t i, float & x, float & y) {
+            x = vertices[i].pos.x;
+            y = vertices[i].pos.y;
+            return !vertices[i].destroyed;
+        });
+        spatialIndexStale = false;
+    }
+
+    // The index of the grabbed vertex, or -1 if none is grabbed or it was destroyed
+    int grabbedIndex() const {
+        uint32_t index = handles.resolve(grabbed);
+        return index == UINT32_MAX ? -1 : (int)index;
+    }
+
+    void wakeFragmentOf(uint32_t vertex) {
+        if (fragmentOf[vertex] != UINT32_MAX) setFragmentAsleep(fragmentOf[vertex], false);
+    }
+
+    void destroyVertex(uint32_t vertex) {
+        vertices[vertex].destroyed = true;
+        ++destroyedVertices;
+        topologyChanged = true;
+        handles.release(vertex);
+        if (fragmentOf[vertex] == UINT32_MAX) return;
+        removeFromFragment(vertex);
+        sleepingVertices[vertex] = 0;
+    }
+
+    /**
+     * @brief Sends fragments that have been quiet for stepsToSleep steps to sleep, and destroys fragments without a fixed
+     * vertex once they are entirely below cullHeight. Motion is only sampled on the steps this runs, every fragmentCheckInterval steps
+     * 
+     */
+    void updateFragments() {
+        fragmentMotion.assign(fragments.size(), 0.0f);
+        fragmentTop.assign(fragments.size(), std::numeric_limits<float>::max());
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            const Vertex & v = vertices[i];
+            if (v.destroyed || sleepingVertices[i]) continue;
+            uint32_t fragment = fragmentOf[i];
+            fragmentMotion[fragment] = std::max(fragmentMotion[fragment], glm::dot(v.pos - v.prevPos, v.pos - v.prevPos));
+            fragmentTop[fragment] = std::min(fragmentTop[fragment], v.pos.y);
+        }
+
+        // Fragments that are held by an attachment count as moving, so they never sleep
+        for (const Attachment & attachment : attachments) {
+            uint32_t index = handles.resolve(attachment.particle);
+            if (index != UINT32_MAX) fragmentMotion[fragmentOf[index]] = std::numeric_limits<float>::max();
+        }
+        std::vector<uint32_t> culled;
+        for (uint32_t f = 0; f < fragments.size(); ++f) {
+            Fragment & fragment = fragments[f];
+            if (fragment.members.empty() || fragment.asleep) continue;
+            if (fragment.fixed == 0 && fragmentTop[f] > cullHeight) {
+                culled.push_back(f);
+                continue;
+            }
+            // A moving collider can reach any fragment at any time
+            bool quiet = fragmentMotion[f] < sleepThreshold * sleepThreshold && !hasMovingColliders();
+            fragment.quietChecks = quiet ? fragment.quietChecks + 1 : 0;
+            if (fragment.quietChecks * fragmentCheckInterval >= (uint32_t)stepsToSleep) setFragmentAsleep(f, true);
+        }
+        // Destroying a vertex takes it out of the member list, which therefore empties from the back
+        for (uint32_t f : culled) {
+            while (!fragments[f].members.empty()) destroyVertex(fragments[f].members.back());
+        }
+    }
+
+    /**
+     * @brief Removes destroyed vertices and every constraint that touches one, and renumbers the rest in their previous order.
+     * Constraints keep their colour and their order within it, so the simulation continues exactly as before.
+     * A grid remembers where its remaining vertices sit in it, so that it is still drawn with level of detail
+     * 
+     * @param removed if given, receives the indices of the removed vertices before the compaction, in increasing order
+     */
+    void compact(std::vector<uint32_t> * removed = nullptr) {
+        std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+        std::vector<Vertex> live;
+        live.reserve(vertices.size() - destroyedVertices);
+        if (removed) removed->clear();
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            if (vertices[i].destroyed) {
+                if (removed) removed->push_back(i);
+                continue;
             }
-            glEnd();
+            remap[i] = live.size();
+            live.push_back(vertices[i]);
         }
 
-        for (int c = 0; c < cols; ++c) {
-            glBegin(GL_LINE_STRIP);
-            for (int r = 0; r < rows; ++r) {
-                if (vertices[r][c].destroyed) {
-                    glEnd();
-                    glBegin(GL_LINE_STRIP);
-                    continue;
+        auto compactConstraints = [&](ArrayStore<Constraint> & store, std::vector<uint32_t> & colours) {
+            std::vector<Constraint> kept;
+            std::vector<uint32_t> starts(1, 0);
+            for (size_t colour = 0; colour + 1 < colours.size(); ++colour) {
+                for (uint32_t i = colours[colour]; i < colours[colour + 1]; ++i) {
+                    uint32_t a = remap[store[i].a];
+                    uint32_t b = remap[store[i].b];
+                    if (a != UINT32_MAX && b != UINT32_MAX) kept.push_back(Constraint{ a, b, store[i].restLength });
                 }
-                glm::fvec3 pos = vertices[r][c].pos;
-                glVertex3f(pos.x, pos.y, pos.z);
+                starts.push_back(kept.size());
+            }
+            store.assign(std::move(kept));
+            colours = std::move(starts);
+        };
+        compactConstraints(constraints, constraintColours);
+        compactConstraints(bendingConstraints, bendingColours);
+
+        handles.remap(remap, live.size());
+        if (isGrid()) {
+            if (gridVertices.empty()) {
+                gridVertices.resize(rows * cols);
+                std::iota(gridVertices.begin(), gridVertices.end(), 0u);
+            }
+            for (uint32_t & vertex : gridVertices) {
+                if (vertex != UINT32_MAX) vertex = remap[vertex];
             }
-            glEnd();
         }
-        glfwSwapBuffers(window);
+        std::vector<uint8_t> state = fragmentState();
+        for (size_t i = 0; i < remap.size(); ++i) {
+            if (remap[i] != UINT32_MAX) state[remap[i]] = state[i];
+        }
+        vertices.assign(std::move(live));
+        destroyedVertices = 0;
+        spatialIndexStale = true;
+        buildAdjacency();
+        buildFragments(state.data());
+        resetRenderState();
+        changedLines.clear();
     }
-};
 
-void cursor_pos_callback(GLFWwindow * window, double xpos, double ypos) {
-    Cloth * cloth = static_cast<Cloth *>(glfwGetWindowUserPointer(window));
-    // If the mouse is moved, set the mouse position in the cloth
-    cloth->setMousePosition(xpos, ypos);
-}
+    /**
+     * @brief Calls f(chunk, begin, end) for every chunk of a range, on the solver threads
+     * 
+     * @return the number of chunks
+     */
+    template <typename F>
+    size_t forEachChunk(size_t begin, size_t end, size_t chunkSize, F && f) {
+        size_t chunks = (end - begin + chunkSize - 1) / chunkSize;
+        auto body = [&](size_t chunk) {
+            size_t first = begin + chunk * chunkSize;
+            f(chunk, first, std::min(end, first + chunkSize));
+        };
+        if (pool) pool->parallelFor(chunks, body);
+        else for (size_t chunk = 0; chunk < chunks; ++chunk) body(chunk);
+        return chunks;
+    }
 
-void mouse_button_callback(GLFWwindow * window, int button, int action, int mods) {
-    Cloth * cloth = static_cast<Cloth *>(glfwGetWindowUserPointer(window));
-    if (button == GLFW_MOUSE_BUTTON_LEFT) {
-        if (action == GLFW_PRESS) {
-            // If left mouse button is pressed, try to grab a point
-            double xpos, ypos;
-            glfwGetCursorPos(window, &xpos, &ypos);
-            cloth->grabPoint(xpos, ypos);
+    // Marks everything as changed so that the next draw uploads the whole cloth
+    void resetRenderState() {
+        uploadedPositions.assign(vertices.size(), glm::fvec3(0));
+        dirtyTiles.assign((vertices.size() + tileSize - 1) / tileSize, 1);
+        topologyChanged = true;
+    }
+
+    /**
+     * @brief Writes the vertices, constraints and solver parameters to a snapshot file that loadSnapshot() can map
+     * 
+     * @param path where to write the snapshot
+     * @param runtime if given, the state of the cloth is filled in and stored as well, which makes the snapshot a checkpoint
+     * @return false if the snapshot could not be written
+     */
+    bool saveSnapshot(const std::string & path, SnapshotRuntimeState * runtime = nullptr) const {
+        SnapshotWriter writer;
+        SnapshotHeader & header = writer.getHeader();
+        header.rows = rows;
+        header.cols = cols;
+        header.segmentLength = segmentLength;
+        header.drag = params.drag;
+        header.iterations = params.iterations;
+        header.breakingLimit = params.breakingLimit;
+        header.bendingStiffness = params.bendingStiffness;
+        writer.addSection(SectionVertices, vertices.data(), vertices.size(), sizeof(Vertex));
+        writer.addSection(SectionConstraints, constraints.data(), constraints.size(), sizeof(Constraint));
+        writer.addSection(SectionConstraintColours, constraintColours.data(), constraintColours.size(), sizeof(uint32_t));
+        if (!bendingConstraints.empty()) {
+            writer.addSection(SectionBendingConstraints, bendingConstraints.data(), bendingConstraints.size(), sizeof(Constraint));
+            writer.addSection(SectionBendingColours, bendingColours.data(), bendingColours.size(), sizeof(uint32_t));
+        }
+        writer.addSection(SectionAdjacency, adjacency.data(), adjacency.size(), sizeof(uint32_t));
+        writer.addSection(SectionAdjacencyStart, adjacencyStart.data(), adjacencyStart.size(), sizeof(uint32_t));
+        writer.addSection(SectionAdjacencyCount, adjacencyCount.data(), adjacencyCount.size(), sizeof(uint32_t));
+        std::vector<uint32_t> labels = fragmentLabels();
+        writer.addSection(SectionFragments, labels.data(), labels.size(), sizeof(uint32_t));
+        if (!gridVertices.empty()) writer.addSection(SectionGridVertices, gridVertices.data(), gridVertices.size(), sizeof(uint32_t));
+        if (runtime) {
+            runtime->step = step;
+            runtime->grabbedIndex = grabbedIndex();
+            runtime->simulationTime = simulationTime;
+            runtime->timeSinceLastMouse = timeSinceLastMouse;
+            std::memcpy(runtime->mousePosition, &mousePosition, sizeof(runtime->mousePosition));
+            runtime->quietSteps = quietSteps;
+            runtime->rightMousePressed = rightMousePressed;
+            runtime->asleep = asleep;
+            writer.addSection(SectionRuntimeState, runtime, 1, sizeof(SnapshotRuntimeState));
+        }
+        std::vector<uint8_t> fragmentStates;
+        if (runtime) {
+            fragmentStates = fragmentState();
+            writer.addSection(SectionFragmentState, fragmentStates.data(), fragmentStates.size(), 1);
         }
-        else if (action == GLFW_RELEASE) {
-            cloth->releasePoint();
+        std::vector<SnapshotAttachment> attached;
+        if (runtime) {
+            for (const Attachment & attachment : attachments) {
+                uint32_t index = handles.resolve(attachment.particle);
+                if (index == UINT32_MAX) continue;
+                glm::fvec3 target = attachment.target;
+                attached.push_back(SnapshotAttachment{ index, { target.x, target.y, target.z }, attachment.stiffness });
+            }
+            if (!attached.empty()) writer.addSection(SectionAttachments, attached.data(), attached.size(), sizeof(SnapshotAttachment));
         }
+        return writer.write(path);
     }
-    if (button == GLFW_MOUSE_BUTTON_RIGHT) {
-        if (action == GLFW_PRESS) {
-            double xpos, ypos;
-            glfwGetCursorPos(window, &xpos, &ypos);
-            // If right mouse button is pressed, inform the cloth that it is pressed
-            cloth->pressRightMouseButton(xpos,ypos);
+
+    /**
+     * @brief Replaces the cloth with a snapshot. The file is memory mapped and its arrays are used as the
+     * vertex and constraint storage directly, so loading does not depend on the size of the cloth
+     * 
+     * @param path the snapshot to load
+     * @param runtime if given, the snapshot must be a checkpoint and the cloth continues exactly where it was saved.
+     * Otherwise the cloth starts over at step 0 from the saved vertices
+     * @param checkIndices whether every vertex and constraint index in the constraints and their index is checked, which
+     * takes time in proportion to the number of constraints. The asset cache skips it for the snapshots it wrote itself
+     * @return false if the file is not a compatible snapshot, in which case the cloth is unchanged
+     */
+    bool loadSnapshot(const std::string & path, SnapshotRuntimeState * runtime = nullptr, bool checkIndices = true) {
+        std::shared_ptr<MappedFile> file = MappedFile::open(path);
+        if (!file) return false;
+        const SnapshotHeader * header = readSnapshotHeader(*file);
+        if (!header || !checkSnapshotSection(*file, *header, SectionVertices, sizeof(Vertex)) ||
+            !checkSnapshotSection(*file, *header, SectionConstraints, sizeof(Constraint))) {
+            return false;
+        }
+
+        bool hasBending = header->sections[SectionBendingConstraints].present;
+        if (hasBending && !checkSnapshotSection(*file, *header, SectionBendingConstraints, sizeof(Constraint))) return false;
+        if (runtime && !checkSnapshotSection(*file, *header, SectionRuntimeState, sizeof(SnapshotRuntimeState))) return false;
+        bool hasFragmentState = runtime && header->sections[SectionFragmentState].present;
+        if (hasFragmentState && (!checkSnapshotSection(*file, *header, SectionFragmentState, 1) ||
+                                 header->sections[SectionFragmentState].count != header->sections[SectionVertices].count)) {
+            return false;
+        }
+        bool hasAttachments = runtime && header->sections[SectionAttachments].present;
+        if (hasAttachments && !checkSnapshotSection(*file, *header, SectionAttachments, sizeof(SnapshotAttachment))) return false;
+
+        const SnapshotSectionEntry & vertexEntry = header->sections[SectionVertices];
+        const SnapshotSectionEntry & constraintEntry = header->sections[SectionConstraints];
+        const SnapshotSectionEntry & bendingEntry = header->sections[SectionBendingConstraints];
+        bool isMesh = header->rows == 0 && header->cols == 0;
+        bool hasGridVertices = !isMesh && header->sections[SectionGridVertices].present;
+        if (!isMesh && !hasGridVertices && (uint64_t)header->rows * header->cols > vertexEntry.count) {
+            std::cerr << "Snapshot grid size does not match its vertex count" << std::endl;
+            return false;
+        }
+        // A compacted grid keeps its remaining vertices in grid order
+        const SnapshotSectionEntry & gridEntry = header->sections[SectionGridVertices];
+        const uint32_t * storedGrid = reinterpret_cast<const uint32_t *>(file->data() + gridEntry.offset);
+        if (hasGridVertices) {
+            bool valid = checkSnapshotSection(*file, *header, SectionGridVertices, sizeof(uint32_t)) &&
+                         gridEntry.count == (uint64_t)header->rows * header->cols;
+            uint64_t next = 0;
+            for (uint64_t position = 0; valid && position < gridEntry.count; ++position) {
+                if (storedGrid[position] == UINT32_MAX) continue;
+                valid = storedGrid[position] >= next && storedGrid[position] < vertexEntry.count;
+                next = storedGrid[position] + 1;
+            }
+            if (!valid) {
+                std::cerr << "Snapshot grid vertices are invalid" << std::endl;
+                return false;
+            }
+        }
+        for (const SnapshotSectionEntry * entry : { &constraintEntry, &bendingEntry }) {
+            if (!entry->present || !checkIndices) continue;
+            for (uint64_t i = 0; i < entry->count; ++i) {
+                const Constraint & constraint = reinterpret_cast<const Constraint *>(file->data() + entry->offset)[i];
+                if (constraint.a >= vertexEntry.count || constraint.b >= vertexEntry.count) {
+                    std::cerr << "Snapshot constraint " << i << " refers to a missing vertex" << std::endl;
+                    return false;
+                }
+            }
+        }
+        // Colour ranges must start at 0, never decrease and end at the number of constraints
+        std::vector<uint32_t> colours[2];
+        const SnapshotSection colourSections[2] = { SectionConstraintColours, SectionBendingColours };
+        const SnapshotSectionEntry * colouredEntries[2] = { &constraintEntry, &bendingEntry };
+        for (int k = 0; k < 2; ++k) {
+            if (!colouredEntries[k]->present) continue;
+            if (!checkSnapshotSection(*file, *header, colourSections[k], sizeof(uint32_t))) return false;
+            const SnapshotSectionEntry & entry = header->sections[colourSections[k]];
+            const uint32_t * starts = reinterpret_cast<const uint32_t *>(file->data() + entry.offset);
+            bool valid = entry.count > 0 && starts[0] == 0 && starts[entry.count - 1] == colouredEntries[k]->count;
+            for (uint64_t c = 1; c < entry.count && valid; ++c) valid = starts[c - 1] <= starts[c];
+            if (!valid) {
+                std::cerr << "Snapshot section " << colourSections[k] << " does not divide the constraints into colours" << std::endl;
+                return false;
+            }
+            colours[k].assign(starts, starts + entry.count);
+        }
+
+        // The index of the constraints by vertex: every vertex has a range of entries, and every entry names a constraint at that vertex
+        const SnapshotSection indexSections[4] = { SectionAdjacency, SectionAdjacencyStart, SectionAdjacencyCount, SectionFragments };
+        for (SnapshotSection section : indexSections) {
+            if (!checkSnapshotSection(*file, *header, section, sizeof(uint32_t))) return false;
+            if (section != SectionAdjacency && header->sections[section].count != vertexEntry.count) {
+                std::cerr << "Snapshot section " << section << " does not match the vertex count" << std::endl;
+                return false;
+            }
+        }
+        auto sectionData = [&](SnapshotSection section) {
+            return reinterpret_cast<const uint32_t *>(file->data() + header->sections[section].offset);
+        };
+        const uint32_t * storedAdjacency = sectionData(SectionAdjacency);
+        const uint32_t * storedStart = sectionData(SectionAdjacencyStart);
+        const uint32_t * storedCount = sectionData(SectionAdjacencyCount);
+        const Constraint * storedConstraints = reinterpret_cast<const Constraint *>(file->data() + constraintEntry.offset);
+        const Constraint * storedBending = reinterpret_cast<const Constraint *>(file->data() + bendingEntry.offset);
+        for (uint64_t v = 0; v < vertexEntry.count && checkIndices; ++v) {
+            bool valid = (uint64_t)storedStart[v] + storedCount[v] <= header->sections[SectionAdjacency].count;
+            for (uint64_t e = storedStart[v]; valid && e < (uint64_t)storedStart[v] + storedCount[v]; ++e) {
+                uint32_t index = storedAdjacency[e] & ~bendingFlag;
+                bool bending = storedAdjacency[e] & bendingFlag;
+                valid = index < (bending ? (hasBending ? bendingEntry.count : 0) : constraintEntry.count);
+                const Constraint * constraint = valid ? (bending ? storedBending : storedConstraints) + index : nullptr;
+                valid = valid && (constraint->a == v || constraint->b == v);
+            }
+            if (!valid) {
+                std::cerr << "Snapshot index of the constraints at vertex " << v << " is invalid" << std::endl;
+                return false;
+            }
+        }
+        // Fragment labels decide the size of the fragment table, so they are always checked
+        const uint32_t * labels = sectionData(SectionFragments);
+        const Vertex * storedVertices = reinterpret_cast<const Vertex *>(file->data() + vertexEntry.offset);
+        for (uint64_t v = 0; v < vertexEntry.count; ++v) {
+            if ((labels[v] == UINT32_MAX) != storedVertices[v].destroyed || (labels[v] != UINT32_MAX && labels[v] >= vertexEntry.count)) {
+                std::cerr << "Snapshot fragment of vertex " << v << " is invalid" << std::endl;
+                return false;
+            }
+        }
+
+        const SnapshotSectionEntry & attachmentEntry = header->sections[SectionAttachments];
+        const SnapshotAttachment * attached = reinterpret_cast<const SnapshotAttachment *>(file->data() + attachmentEntry.offset);
+        for (uint64_t i = 0; hasAttachments && i < attachmentEntry.count; ++i) {
+            if (attached[i].vertex >= vertexEntry.count) {
+                std::cerr << "Snapshot attachment " << i << " refers to a missing vertex" << std::endl;
+                return false;
+            }
         }
-        else if (action == GLFW_RELEASE) {
-            cloth->releaseLeftMouseButton();
+
+        rows = header->rows;
+        cols = header->cols;
+        if (hasGridVertices) gridVertices.assign(storedGrid, storedGrid + gridEntry.count);
+        else gridVertices.clear();
+        segmentLength = header->segmentLength;
+        params.drag = header->drag;
+        params.iterations = header->iterations;
+        params.breakingLimit = header->breakingLimit;
+        params.bendingStiffness = header->bendingStiffness;
+        vertices.view(file, vertexEntry.offset, vertexEntry.count);
+        constraints.view(file, constraintEntry.offset, constraintEntry.count);
+        if (hasBending) bendingConstraints.view(file, bendingEntry.offset, bendingEntry.count);
+        else bendingConstraints.assign({});
+
+        handles.clear();
+        grabbed = ParticleHandle();
+        attachments.clear();
+        spatialIndexStale = true;
+        rightMousePressed = false;
+        wake();
+        step = 0;
+        simulationTime = 0.0;
+        timeSinceLastMouse = 0.0;
+        if (runtime) {
+            std::memcpy(runtime, file->data() + header->sections[SectionRuntimeState].offset, sizeof(SnapshotRuntimeState));
+            step = runtime->step;
+            simulationTime = runtime->simulationTime;
+            timeSinceLastMouse = runtime->timeSinceLastMouse;
+            std::memcpy(&mousePosition, runtime->mousePosition, sizeof(runtime->mousePosition));
+            quietSteps = runtime->quietSteps;
+            rightMousePressed = runtime->rightMousePressed;
+            asleep = runtime->asleep;
+            if (runtime->grabbedIndex >= 0 && (uint64_t)runtime->grabbedIndex < vertices.size() && !vertices[runtime->grabbedIndex].destroyed) {
+                grabbed = handles.acquire(runtime->grabbedIndex);
+            }
+            for (uint64_t i = 0; hasAttachments && i < attachmentEntry.count; ++i) {
+                const SnapshotAttachment & attachment = attached[i];
+                glm::fvec3 target(attachment.target[0], attachment.target[1], attachment.target[2]);
+                attachments.push_back(Attachment{ handles.acquire(attachment.vertex), target, attachment.stiffness });
+            }
         }
+        // The stored colours keep the solver order of the saved cloth, which tearing may have made different from a fresh colouring.
+        // The index of the constraints is mapped like the constraints themselves
+        constraintColours = std::move(colours[0]);
+        bendingColours = hasBending ? std::move(colours[1]) : std::vector<uint32_t>(1, 0);
+        adjacency.view(file, header->sections[SectionAdjacency].offset, header->sections[SectionAdjacency].count);
+        adjacencyStart.view(file, header->sections[SectionAdjacencyStart].offset, vertexEntry.count);
+        adjacencyCount.view(file, header->sections[SectionAdjacencyCount].offset, vertexEntry.count);
+        destroyedVertices = 0;
+        for (const Vertex & vertex : vertices) destroyedVertices += vertex.destroyed;
+        loadFragments(labels, hasFragmentState ? file->data() + header->sections[SectionFragmentState].offset : nullptr);
+        resetRenderState();
+        return true;
     }
-}
 
-int main() {
-    if (!glfwInit()) {
-        std::cerr << "Could not initialize GLFW" << std::endl;
-        return -1;
+    void releaseLeftMouseButton() {
+        rightMousePressed = false;
     }
 
-    int width = 2000;
-    int height = 1500;
+    void pressRightMouseButton(double x, double y) {
+        rightMousePressed = true;
+        wake();
+    }
 
-    GLFWwindow * window = glfwCreateWindow(width, height, "Cloth Simulation", NULL, NULL);
-    if (!window) {
-        std::cerr << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+    void releasePoint() {
+        detach(grabbed);
+        grabbed = ParticleHandle();
+        wake();
     }
-    
-    glfwMakeContextCurrent(window);
 
-    glEnable(GL_DEPTH_TEST);
+    bool isAsleep() const {
+        return asleep;
+    }
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, width, height,0, -10, 10);
+    uint32_t getStep() const {
+        return step;
+    }
 
-    // Set callbacks for mouse events
-    glfwSetMouseButtonCallback(window, mouse_button_callback);
-    glfwSetCursorPosCallback(window, cursor_pos_callback);
-    
-    int rows = 60;
-    int cols = 100;
-    float segmentLength = 10;
-    
-    Cloth cloth(glm::fvec3(500, 0, 0), segmentLength,rows, cols);
+    size_t vertexCount() const {
+        return vertices.size();
+    }
 
-    glfwSetWindowUserPointer(window, &cloth);
+    /**
+     * @brief Hashes the positions, previous positions and destroyed flags of all vertices, which together decide every later step.
+     * The fields are hashed rather than the raw vertices, whose padding bytes are undefined
+     * 
+     */
+    uint64_t stateHash() const {
+        std::vector<float> state;
+        state.reserve(vertices.size() * 7);
+        for (const Vertex & v : vertices) {
+            state.insert(state.end(), { v.pos.x, v.pos.y, v.pos.z, v.prevPos.x, v.prevPos.y, v.prevPos.z, v.destroyed ? 1.0f : 0.0f });
+        }
+        return AssetCache::hash(state.data(), state.size() * sizeof(float));
+    }
 
-    double lastUpdateTime = glfwGetTime();
-    float dt = 0;
-    
-    while (!glfwWindowShouldClose(window)) {
-        // Calculate the time since the last update (deltaTime dt)
-        dt = glfwGetTime() - lastUpdateTime;
-        lastUpdateTime = glfwGetTime();
-        cloth.draw(window);
-        cloth.update(dt);
-        glfwPollEvents();
+    /**
+     * @brief Copies the position and destroyed flag of every vertex, for example to record the current frame
+     * 
+     */
+    void copyState(std::vector<glm::fvec3> & positions, std::vector<uint8_t> & destroyed) const {
+        positions.resize(vertices.size());
+        destroyed.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            positions[i] = vertices[i].pos;
+            destroyed[i] = vertices[i].destroyed;
+        }
     }
-    
-    glfwTerminate();    
+
+    /**
+     * @brief Overwrites the position and destroyed flag of every vertex, used to play back a recording.
+     * Vertices that tearing split off during the recording are added without constraints, since recordings
+     * do not store which constraints moved to them. Compactions of the recorded cloth since the previous frame are
+     * repeated first. Each names the vertices it removed, since frames in between may have been dropped
+     * 
+     * @param compactions the vertices every compaction removed, by their index before it, in the order of the compactions
+     * @return false if the recording does not match the vertices of the cloth
+     */
+    bool setState(const std::vector<glm::fvec3> & positions, const std::vector<uint8_t> & destroyed,
+                  const std::vector<std::vector<uint32_t>> & compactions) {
+        if (destroyed.size() != positions.size()) return false;
+        for (const std::vector<uint32_t> & removed : compactions) {
+            if (!removed.empty() && removed.back() >= vertices.size()) return false;
+            for (uint32_t i : removed) {
+                if (!vertices[i].destroyed) destroyVertex(i);
+            }
+            // Vertices destroyed here but not by the recorded cloth would be lost, and the indices would no longer line up
+            if (destroyedVertices != removed.size()) return false;
+            compact();
+        }
+        if (positions.size() < vertices.size()) return false;
+        while (vertices.size() < positions.size()) {
+            glm::fvec3 p = positions[vertices.size()];
+            vertices.push_back(Vertex(p.x, p.y, p.z, glm::fvec3(0), false));
+            adjacencyStart.push_back(adjacency.size());
+            adjacencyCount.push_back(0);
+            fragmentOf.push_back(UINT32_MAX);
+            memberIndex.push_back(UINT32_MAX);
+            fragments.push_back(Fragment());
+            addToFragment(vertices.size() - 1, fragments.size() - 1);
+            sleepingVertices.push_back(0);
+            uploadedPositions.push_back(glm::fvec3(0));
+            dirtyTiles.resize((vertices.size() + tileSize - 1) / tileSize, 1);
+        }
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            vertices[i].prevPos = vertices[i].pos;
+            vertices[i].pos = positions[i];
+            if (vertices[i].destroyed != (destroyed[i] != 0)) {
+                vertices[i].destroyed = destroyed[i] != 0;
+                destroyedVertices += vertices[i].destroyed ? 1 : -1;
+                if (vertices[i].destroyed) handles.release(i);
+                topologyChanged = true;
+            }
+        }
+        spatialIndexStale = true;
+        markDirtyTiles();
+        return true;
+    }
+
+    // Wakes the cloth and every sleeping fragment
+    void wake() {
+        asleep = false;
+        quietSteps = 0;
+        bool sleeping = false;
+        for (Fragment & fragment : fragments) {
+            sleeping = sleeping || fragment.asleep;
+            fragment.asleep = false;
+            fragment.quietChecks = 0;
+        }
+        if (sleeping) sleepingVertices.assign(sleepingVertices.size(), 0);
+    }
+    
+    bool isGrabbingPoint() {
+        return grabbedIndex() >= 0;
+    }
+
+    /**
+     * @brief Sets the mouse position and destroys vertices close to it if the right mouse button is pressed
+     * 
+     * 
+     * @param x 
+     * @param y 
+     */
+    void setMousePosition(double x, double y) {
+        mousePosition = glm::fvec3(x, y, 0);
+        int grabbedVertex = grabbedIndex();
+        if (grabbedVertex >= 0) {
+            mousePosition.z = vertices[grabbedVertex].pos.z;
+            moveAttachment(grabbed, mousePosition);
+        }
+
+        // Only destroy vertices if right mouse button is pressed and only 60 times per simulated second,
+        // which keeps tearing independent of the wall clock when input is replayed
+        if (!rightMousePressed || simulationTime - timeSinceLastMouse < 1 / 60.0f) return;
+        timeSinceLastMouse = simulationTime;
+
+        ScopedTimer timer(Phase::Tearing);
+        // If a vertex is close enough to the mouse position, destroy it
+        std::vector<uint32_t> cut;
+        updateSpatialIndex();
+        spatialIndex.query(x, y, pickRadius, [&](uint32_t i) {
+            const Vertex & v = vertices[i];
+            double distance = glm::length(v.pos - glm::fvec3(x, y, v.pos.z));
+            if (distance < pickRadius && !v.destroyed) cut.push_back(i);
+        });
+        if (cut.empty()) return;
+        std::sort(cut.begin(), cut.end());
+
+        // The pieces on the edges of the cut may come loose, so they are woken up
+        for (uint32_t i : cut) destroyVertex(i);
+        std::vector<uint32_t> seeds;
+        for (uint32_t i : cut) {
+            forEachNeighbour(i, [&](uint32_t other) { seeds.push_back(other); });
+        }
+        for (uint32_t seed : seeds) wakeFragmentOf(seed);
+        separateFragments(seeds);
+    }
+    
+    /**
+     * @brief Grabs a point if the mouse is close enough to it
+     * 
+     * @param x the x-coordinate of the mouse in screen space
+     * @param y the y-coordinate of the mouse in screen space
+     */
+    void grabPoint(double x, double y) {
+        if (grabbedIndex() >= 0) return;
+        ParticleHandle particle = findParticle(x, y, pickRadius);
+        uint32_t index = handles.resolve(particle);
+        if (index == UINT32_MAX) return;
+        mousePosition = glm::fvec3(x, y, vertices[index].pos.z);
+        if (attach(particle, mousePosition, grabStiffness)) grabbed = particle;
+    }
+
+    /**
+     * @brief Finds the first live particle in storage order within a distance of a point, ignoring depth
+     * 
+     * @param x the x-coordinate of the point
+     * @param y the y-coordinate of the point
+     * @param radius the largest distance
+     * @return the handle of the particle, or a handle to nothing if none is close enough
+     */
+    ParticleHandle findParticle(double x, double y, double radius) {
+        updateSpatialIndex();
+        uint32_t found = UINT32_MAX;
+        spatialIndex.query(x, y, radius, [&](uint32_t i) {
+            if (i >= found || vertices[i].destroyed) return;
+            double distance = glm::length(vertices[i].pos - glm::fvec3(x, y, vertices[i].pos.z));
+            if (distance < radius) found = i;
+        });
+        return found == UINT32_MAX ? ParticleHandle() : handles.acquire(found);
+    }
+
+    /**
+     * @brief Pulls a particle towards a target inside the solver, replacing any earlier attachment of the particle.
+     * The attachment ends when the particle is destroyed
+     * 
+     * @param particle the handle of the particle
+     * @param target where the particle is pulled to
+     * @param stiffness the fraction of the distance to the target that is corrected per iteration, 1 holds the particle in place
+     * @return false if the particle no longer exists
+     */
+    bool attach(ParticleHandle particle, glm::fvec3 target, float stiffness) {
+        uint32_t index = handles.resolve(particle);
+        if (index == UINT32_MAX) return false;
+        detach(particle);
+        attachments.push_back(Attachment{ particle, target, stiffness });
+        wakeFragmentOf(index);
+        wake();
+        return true;
+    }
+
+    /**
+     * @brief Moves the target of an attachment
+     * 
+     * @param particle the handle of the attached particle
+     * @param target where the particle is pulled to
+     * @return false if the particle is not attached
+     */
+    bool moveAttachment(ParticleHandle particle, glm::fvec3 target) {
+        for (Attachment & attachment : attachments) {
+            if (attachment.particle != particle) continue;
+            attachment.target = target;
+            wake();
+            return true;
+        }
+        return false;
+    }
+
+    void detach(ParticleHandle particle) {
+        attachments.erase(std::remove_if(attachments.begin(), attachments.end(),
+                                         [&](const Attachment & attachment) { return attachment.particle == particle; }),
+                          attachments.end());
+    }
+
+    /**
+     * @brief Fixes a particle in place or frees it again
+     * 
+     * @param particle the handle of the particle
+     * @param pinned whether the particle is fixed
+     * @return false if the particle no longer exists
+     */
+    bool setPinned(ParticleHandle particle, bool pinned) {
+        uint32_t index = handles.resolve(particle);
+        if (index == UINT32_MAX) return false;
+        Vertex & vertex = vertices[index];
+        if (vertex.fixed == pinned) return true;
+        vertex.fixed = pinned;
+        vertex.prevPos = vertex.pos;
+        fragments[fragmentOf[index]].fixed += pinned ? 1 : -1;
+        wakeFragmentOf(index);
+        wake();
+        return true;
+    }
+
+    /**
+     * @brief Copies the current state of a particle
+     * 
+     * @param particle the handle of the particle
+     * @param state receives the particle
+     * @return false if the particle no longer exists
+     */
+    bool getParticle(ParticleHandle particle, Vertex & state) const {
+        uint32_t index = handles.resolve(particle);
+        if (index == UINT32_MAX) return false;
+        state = vertices[index];
+        return true;
+    }
+    
+    /**
+     * @brief Updates the cloth by applying Verlet integration and the Jakobsen method to all vertices
+     * 
+     * @param dt the time since the last update
+     */
+    void update(float dt) {
+        if (asleep) return;
+        ScopedTimer timer(Phase::Update);
+        ++step;
+        simulationTime += dt;
+
+        float drag = params.drag;
+        // The largest squared distance a visible vertex moved during the previous step
+        float maxMotion = 0.0f;
+        // Apply verlet integration to all vertices except the fixed ones
+        {
+            ScopedTimer integrateTimer(Phase::Integrate);
+            chunkMotion.assign((vertices.size() + vertexChunk - 1) / vertexChunk, 0.0f);
+            forEachChunk(0, vertices.size(), vertexChunk, [&](size_t chunk, size_t begin, size_t end) {
+                float motion = 0.0f;
+                for (size_t i = begin; i < end; ++i) {
+                    Vertex & vertex = vertices[i];
+                    if (vertex.fixed || sleepingVertices[i]) continue;
+
+                    // Implementation of Verlet integration
+                    Vertex v = vertex;
+                    glm::fvec3 copy = glm::fvec3(v.pos);
+                    if (!v.destroyed) motion = std::max(motion, glm::dot(v.pos - v.prevPos, v.pos - v.prevPos));
+                    vertex.pos = v.pos + (1.0f - drag) * (v.pos - v.prevPos) + dt * dt* v.mass*v.acceleration;
+                    vertex.prevPos = copy;
+                }
+                chunkMotion[chunk] = motion;
+            });
+            for (float motion : chunkMotion) maxMotion = std::max(maxMotion, motion);
+        }
+
+        // Attachments end with their particle
+        attachments.erase(std::remove_if(attachments.begin(), attachments.end(),
+                                         [&](const Attachment & attachment) { return handles.resolve(attachment.particle) == UINT32_MAX; }),
+                          attachments.end());
+        spatialIndexStale = true;
+
+        for (int i = 0; i < params.iterations; ++i) {
+            ScopedTimer iterationTimer(Phase::ConstraintIteration);
+            satisfyConstraints();
+        }
+
+        resolveCollisions(dt);
+
+        // While a vertex is grabbed the user may pull as hard as they like without tearing the cloth. Other
+        // attachments do not hold off tearing, since they may be scripted and last for the whole simulation
+        if (grabbedIndex() < 0) tearOverstretched();
+        if (step % fragmentCheckInterval == 0) updateFragments();
+
+        markDirtyTiles();
+
+        // Never fall asleep while the user is interacting with the cloth
+        bool quiet = maxMotion < sleepThreshold * sleepThreshold && attachments.empty() && !rightMousePressed && !hasMovingColliders();
+        quietSteps = quiet ? quietSteps + 1 : 0;
+        asleep = quietSteps >= stepsToSleep;
+    }
+
+    /**
+     * @brief Compacts the cloth once enough vertices are destroyed, so that the cost of each step tracks the live vertices
+     * 
+     * @param removed if given, receives the indices of the removed vertices before the compaction
+     * @return true if the cloth was compacted
+     */
+    bool compactIfNeeded(std::vector<uint32_t> * removed = nullptr) {
+        if (destroyedVertices < compactionMinimum || destroyedVertices * 4 < vertices.size()) return false;
+        compact(removed);
+        return true;
+    }
+
+    /**
+     * @brief Marks every tile that contains a vertex which has moved more than dirtyEpsilon since the tile was last uploaded.
+     * Comparing against the uploaded position rather than the previous step keeps slow drifts from accumulating unseen
+     * 
+     */
+    void markDirtyTiles() {
+        float epsilonSquared = dirtyEpsilon * dirtyEpsilon;
+        int count = vertices.size();
+        for (int tile = 0; tile < (int)dirtyTiles.size(); ++tile) {
+            if (dirtyTiles[tile]) continue;
+
+            int begin = tile * tileSize;
+            int end = std::min(count, begin + tileSize);
+            for (int i = begin; i < end; ++i) {
+                glm::fvec3 delta = vertices[i].pos - uploadedPositions[i];
+                if (glm::dot(delta, delta) > epsilonSquared) {
+                    dirtyTiles[tile] = 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Passes every run of consecutive dirty tiles to a consumer and marks them as clean. 
+     * The positions handed out stay valid until the next call, so they can be uploaded to the GPU or copied elsewhere
+     * 
+     * @param upload called as upload(first, count, positions) for each range of row-major vertex indices
+     * @return the number of vertices that were passed on
+     */
+    template <typename F>
+    int syncDirtyRanges(F && upload) {
+        int count = vertices.size();
+        int tiles = dirtyTiles.size();
+        int uploaded = 0;
+        int tile = 0;
+        while (tile < tiles) {
+            if (!dirtyTiles[tile]) {
+                ++tile;
+                continue;
+            }
+            int first = tile;
+            while (tile < tiles && dirtyTiles[tile]) {
+                dirtyTiles[tile] = 0;
+                ++tile;
+            }
+
+            int begin = first * tileSize;
+            int end = std::min(count, tile * tileSize);
+            for (int i = begin; i < end; ++i) {
+                uploadedPositions[i] = vertices[i].pos;
+            }
+            upload(begin, end - begin, &uploadedPositions[begin]);
+            uploaded += end - begin;
+        }
+        return uploaded;
+    }
+
+    /**
+     * @brief Applies the Jakobsen method to all vertices by checking the distance between vertices and moving them accordingly.
+     * The colours are solved one after another and the constraints of one colour in parallel, since they share no vertex
+     * 
+     */
+    void satisfyConstraints() {
+
+        for (size_t colour = 0; colour + 1 < constraintColours.size(); ++colour) {
+            forEachChunk(constraintColours[colour], constraintColours[colour + 1], constraintChunk, [&](size_t, size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    const Constraint & constraint = constraints[i];
+                    Vertex & a = vertices[constraint.a];
+                    Vertex & b = vertices[constraint.b];
+                    // Both vertices of a constraint are in the same fragment, so both or neither sleep
+                    if (a.destroyed || b.destroyed || (a.fixed && b.fixed) || sleepingVertices[constraint.a]) continue;
+
+                    glm::vec3 delta = (a.pos - b.pos);
+                    float distance = glm::length(delta);
+                    float difference = (distance - constraint.restLength) / distance;
+                    // If one of the vertices is fixed, the other vertex is moved the whole distance
+                    // Otherwise, the distance is split between the two vertices
+                    if (b.fixed) {
+                        a.pos -= delta * difference * 1.0f;
+                    }
+                    else if (a.fixed) {
+                        b.pos += delta * difference * 1.0f;
+                    }
+                    else {
+                        a.pos -= delta * difference * 0.5f;
+                        b.pos += delta * difference * 0.5f;
+                    }
+                }
+            });
+        }
+
+        // Bending constraints only correct part of their violation, so the cloth folds but does not crumple
+        float stiffness = params.bendingStiffness;
+        for (size_t colour = 0; colour + 1 < bendingColours.size(); ++colour) {
+            forEachChunk(bendingColours[colour], bendingColours[colour + 1], constraintChunk, [&](size_t, size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    const Constraint & constraint = bendingConstraints[i];
+                    Vertex & a = vertices[constraint.a];
+                    Vertex & b = vertices[constraint.b];
+                    if (a.destroyed || b.destroyed || (a.fixed && b.fixed) || sleepingVertices[constraint.a]) continue;
+
+                    glm::vec3 delta = (a.pos - b.pos);
+                    float distance = glm::length(delta);
+                    if (distance == 0.0f) continue;
+                    glm::vec3 correction = delta * ((distance - constraint.restLength) / distance * stiffness);
+                    if (b.fixed) {
+                        a.pos -= correction;
+                    }
+                    else if (a.fixed) {
+                        b.pos += correction;
+                    }
+                    else {
+                        a.pos -= correction * 0.5f;
+                        b.pos += correction * 0.5f;
+                    }
+                }
+            });
+        }
+
+        // Attachments come last, so an attached particle ends every iteration close to its target and the
+        // constraints spread the pull through the cloth in the next iteration
+        for (const Attachment & attachment : attachments) {
+            uint32_t index = handles.resolve(attachment.particle);
+            if (index == UINT32_MAX || vertices[index].fixed) continue;
+            Vertex & vertex = vertices[index];
+            vertex.pos += (attachment.target - vertex.pos) * attachment.stiffness;
+        }
+    }
+
+    /**
+     * @brief Pushes every particle that is inside a collider out to its surface and takes away the collider's share of its
+     * sliding velocity, then stops particles whose path over the step crosses a mesh collider. Tiles are handled in parallel,
+     * and the particles of a tile are tested in batches against each collider that overlaps the tile's bounding box, in
+     * collider order, so the result does not depend on the thread count
+     * 
+     * @param dt the time step that just ended, over which the moving meshes moved
+     */
+    void resolveCollisions(float dt) {
+        if (colliders.empty() && meshColliders.empty()) return;
+        ScopedTimer timer(Phase::Collision);
+        for (MeshCollider & mesh : meshColliders) mesh.pose(simulationTime);
+        size_t tiles = (vertices.size() + tileSize - 1) / tileSize;
+        forEachChunk(0, tiles, collisionTileChunk, [&](size_t, size_t begin, size_t end) {
+            std::vector<uint32_t> nearby;
+            std::vector<uint32_t> members;
+            std::vector<uint32_t> triangles;
+            ParticleBatch batch;
+            uint32_t lanes[colliderBatch];
+            int inside[colliderBatch];
+            glm::fvec3 starts[colliderBatch];
+            for (size_t tile = begin; tile < end; ++tile) {
+                // Broadphase: the bounding box of the tile's movable particles against every collider
+                members.clear();
+                glm::fvec3 low(std::numeric_limits<float>::max());
+                glm::fvec3 high(-std::numeric_limits<float>::max());
+                size_t last = std::min(vertices.size(), (tile + 1) * tileSize);
+                for (size_t i = tile * tileSize; i < last; ++i) {
+                    const Vertex & v = vertices[i];
+                    if (v.destroyed || v.fixed || sleepingVertices[i]) continue;
+                    members.push_back(i);
+                    low = glm::min(low, v.pos);
+                    high = glm::max(high, v.pos);
+                }
+                if (members.empty()) continue;
+                nearby.clear();
+                for (uint32_t c = 0; c < colliders.size(); ++c) {
+                    if (colliderOverlaps(colliders[c], low, high)) nearby.push_back(c);
+                }
+
+                // Narrowphase: batches of particles against each nearby collider, with exact projection for the few inside
+                for (size_t first = 0; first < members.size() && !nearby.empty(); first += colliderBatch) {
+                    size_t count = std::min(colliderBatch, members.size() - first);
+                    batch.clear();
+                    for (size_t lane = 0; lane < count; ++lane) {
+                        lanes[lane] = members[first + lane];
+                        const glm::fvec3 & pos = vertices[lanes[lane]].pos;
+                        batch.x[lane] = pos.x;
+                        batch.y[lane] = pos.y;
+                        batch.z[lane] = pos.z;
+                    }
+                    for (uint32_t c : nearby) {
+                        const Collider & collider = colliders[c];
+                        if (findContacts(collider, batch, inside) == 0) continue;
+                        for (size_t lane = 0; lane < count; ++lane) {
+                            if (!inside[lane]) continue;
+                            Vertex & vertex = vertices[lanes[lane]];
+                            glm::fvec3 surface = pushOut(collider, vertex.pos);
+                            glm::fvec3 normal = surface - vertex.pos;
+                            float length = glm::length(normal);
+                            vertex.pos = surface;
+                            if (length > 0.0f && collider.friction > 0.0f) {
+                                normal /= length;
+                                glm::fvec3 motion = vertex.pos - vertex.prevPos;
+                                vertex.prevPos += (motion - normal * glm::dot(motion, normal)) * collider.friction;
+                            }
+                            batch.x[lane] = surface.x;
+                            batch.y[lane] = surface.y;
+                            batch.z[lane] = surface.z;
+                        }
+                    }
+                }
+
+                // Meshes: one traversal of the hierarchy per batch, with the bounds of the batch's paths over the step
+                for (const MeshCollider & mesh : meshColliders) {
+                    for (size_t first = 0; first < members.size(); first += colliderBatch) {
+                        size_t count = std::min(colliderBatch, members.size() - first);
+                        glm::fvec3 pathLow(std::numeric_limits<float>::max());
+                        glm::fvec3 pathHigh(-std::numeric_limits<float>::max());
+                        for (size_t lane = 0; lane < count; ++lane) {
+                            const Vertex & vertex = vertices[members[first + lane]];
+                            starts[lane] = mesh.carry(vertex.prevPos, simulationTime - dt, simulationTime);
+                            pathLow = glm::min(pathLow, glm::min(starts[lane], vertex.pos));
+                            pathHigh = glm::max(pathHigh, glm::max(starts[lane], vertex.pos));
+                        }
+                        mesh.query(pathLow, pathHigh, triangles);
+                        if (triangles.empty()) continue;
+                        for (size_t lane = 0; lane < count; ++lane) {
+                            Vertex & vertex = vertices[members[first + lane]];
+                            mesh.sweep(triangles, starts[lane], vertex.pos);
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    bool hasMovingColliders() const {
+        for (const MeshCollider & mesh : meshColliders) {
+            if (mesh.isMoving()) return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Tears every constraint that is stretched to more than breakingLimit times its rest length.
+     * Runs once per step after the solver, comparing squared lengths so that it needs neither a square root nor a
+     * division. All breaks are found before any is applied, and every one of them is applied even when an earlier break
+     * moved the constraint or split one of its vertices, so the result does not depend on the constraint order
+     * 
+     * @return the number of constraints that broke
+     */
+    size_t tearOverstretched() {
+        ScopedTimer timer(Phase::Tearing);
+        float limitSquared = params.breakingLimit * params.breakingLimit;
+        chunkTears.resize((constraints.size() + constraintChunk - 1) / constraintChunk);
+        forEachChunk(0, constraints.size(), constraintChunk, [&](size_t chunk, size_t begin, size_t end) {
+            std::vector<uint32_t> & tears = chunkTears[chunk];
+            tears.clear();
+            for (size_t i = begin; i < end; ++i) {
+                const Constraint & constraint = constraints[i];
+                const Vertex & a = vertices[constraint.a];
+                const Vertex & b = vertices[constraint.b];
+                if (a.destroyed || b.destroyed || (a.fixed && b.fixed) || sleepingVertices[constraint.a]) continue;
+
+                glm::vec3 delta = a.pos - b.pos;
+                if (glm::dot(delta, delta) > limitSquared * constraint.restLength * constraint.restLength) tears.push_back(i);
+            }
+        });
+
+        breakQueue.clear();
+        for (const std::vector<uint32_t> & tears : chunkTears) breakQueue.insert(breakQueue.end(), tears.begin(), tears.end());
+        if (breakQueue.empty()) return 0;
+
+        // Tearing moves constraints to other indices and other vertices, removeConstraint() keeps the queue up to date
+        breakSlot.assign(constraints.size(), UINT32_MAX);
+        for (size_t i = 0; i < breakQueue.size(); ++i) breakSlot[breakQueue[i]] = i;
+        for (size_t i = 0; i < breakQueue.size(); ++i) {
+            if (breakQueue[i] != UINT32_MAX) tearEdge(breakQueue[i]);
+        }
+        breakSlot.clear();
+        return breakQueue.size();
+    }
+
+    /**
+     * @brief Removes a constraint and splits either of its vertices where the tear runs through it.
+     * Only the constraints at the two vertices are touched, so the cost is proportional to their degree
+     * 
+     */
+    void tearEdge(uint32_t edge) {
+        uint32_t a = constraints[edge].a;
+        uint32_t b = constraints[edge].b;
+        glm::fvec3 direction = vertices[b].pos - vertices[a].pos;
+        removeConstraint(edge);
+        std::vector<uint32_t> seeds = { a, b };
+        uint32_t copy = splitVertex(a, direction);
+        if (copy != UINT32_MAX) seeds.push_back(copy);
+        copy = splitVertex(b, -direction);
+        if (copy != UINT32_MAX) seeds.push_back(copy);
+        separateFragments(seeds);
+    }
+
+    // The index of the constraint between two vertices, or -1 if there is none
+    int findConstraint(uint32_t a, uint32_t b) const {
+        for (uint32_t e = adjacencyStart[a]; e < adjacencyStart[a] + adjacencyCount[a]; ++e) {
+            if (adjacency[e] & bendingFlag) continue;
+            const Constraint & constraint = constraints[adjacency[e]];
+            if ((constraint.a == a && constraint.b == b) || (constraint.a == b && constraint.b == a)) return adjacency[e];
+        }
+        return -1;
+    }
+
+    /**
+     * @brief Removes a constraint while keeping the constraints sorted by colour. The hole is filled with the last constraint
+     * of its colour, which leaves a hole at the start of the next colour, and so on, so at most one constraint per colour moves
+     * 
+     */
+    void removeConstraint(uint32_t index) {
+        unlinkAdjacency(constraints[index].a, index);
+        unlinkAdjacency(constraints[index].b, index);
+        changedLines.push_back(index);
+        bool trackBreaks = !breakSlot.empty();
+        if (trackBreaks && breakSlot[index] != UINT32_MAX) {
+            breakQueue[breakSlot[index]] = UINT32_MAX;
+            breakSlot[index] = UINT32_MAX;
+        }
+        size_t colour = std::upper_bound(constraintColours.begin(), constraintColours.end(), index) - constraintColours.begin() - 1;
+        uint32_t hole = index;
+        for (size_t c = colour; c + 1 < constraintColours.size(); ++c) {
+            uint32_t last = constraintColours[c + 1] - 1;
+            if (last != hole) {
+                constraints[hole] = constraints[last];
+                relinkAdjacency(constraints[hole].a, last, hole);
+                relinkAdjacency(constraints[hole].b, last, hole);
+                changedLines.push_back(hole);
+                if (trackBreaks) {
+                    breakSlot[hole] = breakSlot[last];
+                    if (breakSlot[hole] != UINT32_MAX) breakQueue[breakSlot[hole]] = hole;
+                }
+            }
+            hole = last;
+            --constraintColours[c + 1];
+        }
+        constraints.pop_back();
+        if (trackBreaks) breakSlot.pop_back();
+    }
+
+    void unlinkAdjacency(uint32_t vertex, uint32_t entry) {
+        uint32_t * first = &adjacency[adjacencyStart[vertex]];
+        uint32_t * last = first + adjacencyCount[vertex];
+        uint32_t * found = std::find(first, last, entry);
+        if (found == last) return;
+        *found = *(last - 1);
+        --adjacencyCount[vertex];
+    }
+
+    void relinkAdjacency(uint32_t vertex, uint32_t from, uint32_t to) {
+        uint32_t * first = &adjacency[adjacencyStart[vertex]];
+        uint32_t * last = first + adjacencyCount[vertex];
+        std::replace(first, last, from, to);
+    }
+
+    /**
+     * @brief Splits a vertex in two when the constraints left at it lie on both sides of the plane through it that is
+     * perpendicular to the torn constraint. The constraints on the side of the tear move to a new copy of the vertex.
+     * Fixed and destroyed vertices are never split
+     * 
+     * @param direction points from the vertex towards the vertex it was torn from
+     * @return the index of the new vertex, or UINT32_MAX if the vertex was not split
+     */
+    uint32_t splitVertex(uint32_t vertex, glm::fvec3 direction) {
+        if (vertices[vertex].fixed || vertices[vertex].destroyed) return UINT32_MAX;
+        auto other = [&](uint32_t entry) {
+            const Constraint & constraint = entry & bendingFlag ? bendingConstraints[entry & ~bendingFlag] : constraints[entry];
+            return constraint.a == vertex ? constraint.b : constraint.a;
+        };
+        auto towardsTear = [&](uint32_t entry) {
+            return glm::dot(vertices[other(entry)].pos - vertices[vertex].pos, direction) > 0.0f;
+        };
+
+        uint32_t * first = &adjacency[adjacencyStart[vertex]];
+        uint32_t * last = first + adjacencyCount[vertex];
+        uint32_t * middle = std::stable_partition(first, last, [&](uint32_t entry) { return !towardsTear(entry); });
+        if (middle == first || middle == last) return UINT32_MAX;
+
+        uint32_t copy = vertices.size();
+        Vertex duplicate = vertices[vertex];
+        vertices.push_back(duplicate);
+        spatialIndexStale = true;
+        adjacencyStart.push_back(adjacency.size());
+        adjacencyCount.push_back(last - middle);
+        std::vector<uint32_t> moved(middle, last);
+        adjacencyCount[vertex] = middle - first;
+        for (uint32_t entry : moved) {
+            adjacency.push_back(entry);
+            Constraint & constraint = entry & bendingFlag ? bendingConstraints[entry & ~bendingFlag] : constraints[entry];
+            if (constraint.a == vertex) constraint.a = copy;
+            else constraint.b = copy;
+            if (!(entry & bendingFlag)) changedLines.push_back(entry);
+        }
+
+        uploadedPositions.push_back(vertices[copy].pos);
+        dirtyTiles.resize((vertices.size() + tileSize - 1) / tileSize, 0);
+        dirtyTiles[copy / tileSize] = 1;
+
+        // The copy stays in the fragment until separateFragments() finds out whether the tear cut it off
+        fragmentOf.push_back(UINT32_MAX);
+        memberIndex.push_back(UINT32_MAX);
+        addToFragment(copy, fragmentOf[vertex]);
+        sleepingVertices.push_back(sleepingVertices[vertex]);
+        return copy;
+    }
+
+    // Draw all lines between the vertices into the current framebuffer
+    void draw() {
+        ScopedTimer timer(Phase::Draw);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        if (vertexBuffer == 0) {
+            glGenBuffers(1, &vertexBuffer);
+            glGenBuffers(1, &indexBuffer);
+        }
+
+        // Only re-upload the vertices that have moved
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        if (vertexBufferCapacity < vertices.size()) {
+            vertexBufferCapacity = vertexBufferCapacity == 0 ? vertices.size() : std::max(vertices.size(), vertexBufferCapacity * 5 / 4);
+            glBufferData(GL_ARRAY_BUFFER, vertexBufferCapacity * sizeof(glm::fvec3), nullptr, GL_DYNAMIC_DRAW);
+            std::fill(dirtyTiles.begin(), dirtyTiles.end(), 1);
+        }
+        syncDirtyRanges([](int first, int count, const glm::fvec3 * positions) {
+            glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(glm::fvec3), count * sizeof(glm::fvec3), positions);
+        });
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        int stride = chooseLodStride();
+        if (topologyChanged || stride != lodStride || (stride > 1 && grabbedIndex() != lodFocus)) {
+            lodStride = stride;
+            lodFocus = grabbedIndex();
+            rebuildIndexBuffer();
+        }
+        else if (!changedLines.empty()) {
+            if (linePerConstraint) updateChangedLines();
+            else rebuildIndexBuffer();
+        }
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(3, GL_FLOAT, 0, nullptr);
+        glDrawElements(GL_LINES, indexCount, GL_UNSIGNED_INT, nullptr);
+        glDisableClientState(GL_VERTEX_ARRAY);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    /**
+     * @brief Picks the smallest power of two stride at which the rest length between drawn vertices covers at least lodMinSpacing pixels
+     * 
+     * @return the number of vertices between drawn rows and columns
+     */
+    int chooseLodStride() {
+        if (!isGrid()) return 1;
+
+        // Pixels per world unit follow from the horizontal scale of the projection and the viewport width
+        GLfloat projection[16];
+        GLint viewport[4];
+        glGetFloatv(GL_PROJECTION_MATRIX, projection);
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        float projectedLength = segmentLength * std::abs(projection[0]) * viewport[2] * 0.5f;
+
+        int stride = 1;
+        while (projectedLength * stride < lodMinSpacing && stride < std::max(rows, cols)) {
+            stride *= 2;
+        }
+        return stride;
+    }
+
+    // The two indices of a constraint's line, collapsed to a single point when it touches a destroyed vertex
+    void lineOf(uint32_t index, GLuint * line) const {
+        const Constraint & constraint = constraints[index];
+        bool hidden = vertices[constraint.a].destroyed || vertices[constraint.b].destroyed;
+        line[0] = constraint.a;
+        line[1] = hidden ? constraint.a : constraint.b;
+    }
+
+    // Rewrites the lines of the constraints tearing has changed in the bound index buffer
+    void updateChangedLines() {
+        indexCount = 2 * constraints.size();
+        for (uint32_t index : changedLines) {
+            if (index >= constraints.size()) continue;
+            GLuint line[2];
+            lineOf(index, line);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 2 * index * sizeof(GLuint), sizeof(line), line);
+        }
+        changedLines.clear();
+    }
+
+    // Whether a grid vertex has been destroyed, or removed by compaction
+    bool isGridVertexGone(int r, int c) const {
+        uint32_t vertex = gridVertex(r, c);
+        return vertex == UINT32_MAX || vertices[vertex].destroyed;
+    }
+
+    // Whether the constraint between two grid vertices is still intact
+    bool hasGridLine(int r0, int c0, int r1, int c1) const {
+        return findConstraint(gridVertex(r0, c0), gridVertex(r1, c1)) >= 0;
+    }
+
+    // Whether a grid vertex has lost one of its constraints to tearing. Constraints to a neighbour that compaction
+    // removed went with it, like the constraints of a destroyed vertex that are no longer drawn
+    bool isTorn(int r, int c) const {
+        auto kept = [&](int nr, int nc) { return gridVertex(nr, nc) != UINT32_MAX; };
+        uint32_t intact = (r > 0 && kept(r - 1, c)) + (r < rows - 1 && kept(r + 1, c)) +
+                          (c > 0 && kept(r, c - 1)) + (c < cols - 1 && kept(r, c + 1));
+        return adjacencyCount[gridVertex(r, c)] != intact;
+    }
+
+    /**
+     * @brief Rebuilds the line indices into the bound index buffer. At full resolution every constraint gets one line,
+     * in constraint order, so that tearing can update single lines. Lines that touch a destroyed vertex are collapsed.
+     * Zoomed out, the grid is split into blocks of lodStride x lodStride cells. A block is drawn at full resolution if it
+     * contains a destroyed or torn vertex or lies next to the block of the grabbed vertex, otherwise only its top and left
+     * edges are drawn as single lines. The constraints of vertices split off by tearing are always drawn
+     * 
+     */
+    void rebuildIndexBuffer() {
+        std::vector<GLuint> indices;
+        changedLines.clear();
+        linePerConstraint = lodStride == 1;
+        if (linePerConstraint) {
+            indices.resize(2 * constraints.size());
+            for (uint32_t i = 0; i < constraints.size(); ++i) lineOf(i, &indices[2 * i]);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_DYNAMIC_DRAW);
+            indexCount = indices.size();
+            topologyChanged = false;
+            return;
+        }
+
+        auto addLine = [&](int r0, int c0, int r1, int c1) {
+            if (isGridVertexGone(r0, c0) || isGridVertexGone(r1, c1)) return;
+            if (!hasGridLine(r0, c0, r1, c1)) return;
+            indices.push_back(gridVertex(r0, c0));
+            indices.push_back(gridVertex(r1, c1));
+        };
+
+        int s = lodStride;
+        uint32_t gridCount = gridVertexCount();
+        // The grid position of the grabbed vertex, found in the grid order of a compacted grid
+        int focus = grabbedIndex();
+        if (focus >= 0 && (uint32_t)focus >= gridCount) focus = -1;
+        if (focus >= 0 && !gridVertices.empty()) {
+            focus = std::find(gridVertices.begin(), gridVertices.end(), (uint32_t)focus) - gridVertices.begin();
+        }
+        int focusRow = focus >= 0 ? focus / cols / s : -2;
+        int focusCol = focus >= 0 ? focus % cols / s : -2;
+        for (int r0 = 0; r0 < std::max(rows - 1, 1); r0 += s) {
+            int r1 = std::min(r0 + s, rows - 1);
+            // The bottom and right edges of a block belong to the next block, except at the border of the cloth
+            int lastRow = r1 == rows - 1 ? r1 : r1 - 1;
+            for (int c0 = 0; c0 < std::max(cols - 1, 1); c0 += s) {
+                int c1 = std::min(c0 + s, cols - 1);
+                int lastCol = c1 == cols - 1 ? c1 : c1 - 1;
+
+                bool full = s == 1 || (std::abs(r0 / s - focusRow) <= 1 && std::abs(c0 / s - focusCol) <= 1);
+                for (int r = r0; r <= r1 && !full; ++r) {
+                    for (int c = c0; c <= c1; ++c) {
+                        if (isGridVertexGone(r, c) || isTorn(r, c)) {
+                            full = true;
+                            break;
+                        }
+                    }
+                }
+
+                if (full) {
+                    for (int r = r0; r <= lastRow; ++r) {
+                        for (int c = c0; c < c1; ++c) addLine(r, c, r, c + 1);
+                    }
+                    for (int c = c0; c <= lastCol; ++c) {
+                        for (int r = r0; r < r1; ++r) addLine(r, c, r + 1, c);
+                    }
+                }
+                else {
+                    addLine(r0, c0, r0, c1);
+                    if (r1 == rows - 1 && r1 != r0) addLine(r1, c0, r1, c1);
+                    addLine(r0, c0, r1, c0);
+                    if (c1 == cols - 1 && c1 != c0) addLine(r0, c1, r1, c1);
+                }
+            }
+        }
+        // A line between two split off vertices is added by the later one
+        for (uint32_t v = gridCount; v < vertices.size(); ++v) {
+            for (uint32_t e = adjacencyStart[v]; e < adjacencyStart[v] + adjacencyCount[v]; ++e) {
+                if (adjacency[e] & bendingFlag) continue;
+                GLuint line[2];
+                lineOf(adjacency[e], line);
+                uint32_t other = line[0] == v ? line[1] : line[0];
+                if (line[0] != line[1] && other < v) indices.insert(indices.end(), line, line + 2);
+            }
+        }
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_DYNAMIC_DRAW);
+        indexCount = indices.size();
+        topologyChanged = false;
+    }
+};
+
+/**
+ * @brief Passes a mouse event on to the cloth
+ * 
+ */
+void applyInput(Cloth & cloth, const InputEvent & event) {
+    ScopedTimer timer(Phase::Input);
+    switch (event.type) {
+    case InputEventType::CursorMove:
+        // If the mouse is moved, set the mouse position in the cloth
+        cloth.setMousePosition(event.x, event.y);
+        break;
+    case InputEventType::ButtonPress:
+        // If left mouse button is pressed, try to grab a point
+        if (event.button == GLFW_MOUSE_BUTTON_LEFT) cloth.grabPoint(event.x, event.y);
+        // If right mouse button is pressed, inform the cloth that it is pressed
+        if (event.button == GLFW_MOUSE_BUTTON_RIGHT) cloth.pressRightMouseButton(event.x, event.y);
+        break;
+    case InputEventType::ButtonRelease:
+        if (event.button == GLFW_MOUSE_BUTTON_LEFT) cloth.releasePoint();
+        if (event.button == GLFW_MOUSE_BUTTON_RIGHT) cloth.releaseLeftMouseButton();
+        break;
+    case InputEventType::Step:
+        break;
+    }
+}
+
+/*
+Settings given on the command line
+*/
+struct Options {
+    bool headless = false;
+    int frames = 600;
+    float dt = 1 / 60.0f;
+    std::string outputDirectory = "frames";
+    ImageFormat format = ImageFormat::PNG;
+    bool writeFrames = true;
+    std::string loadSnapshot;
+    std::string saveSnapshot;
+    std::string recordPath;
+    float recordPrecision = 0.01f;
+    std::string playbackPath;
+    std::string recordInputPath;
+    std::string replayInputPath;
+    std::string meshPath;
+    float pinFraction = 0.02f;
+    std::string assetCache = "cache";
+    std::string checkpointPath;
+    int checkpointInterval = 600;
+    std::string resumePath;
+    std::string profilePath;
+    int profileInterval = 600;
+    std::string tracePath;
+    int benchmarkSamples = 0;
+    int benchmarkSteps = 50;
+    std::string benchmarkOutput;
+    std::string baselineDirectory = "baselines";
+    std::string machineClass;
+    bool saveBaseline = false;
+    bool compareBaseline = false;
+    float regressionThreshold = 5;
+    std::string writeGoldenPath;
+    std::string verifyGoldenPath;
+    int hashInterval = 10;
+    bool determinismCheck = false;
+    float tolerance = 0;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string collidersPath;
+};
+
+void printUsage(const char * program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --headless               render offscreen without opening a window\n"
+              << "  --frames <n>             number of frames to render in headless mode (default 600)\n"
+              << "  --dt <seconds>           fixed time step used in headless mode (default 1/60)\n"
+              << "  --output <dir>           directory the headless frames are written to (default frames)\n"
+              << "  --format <png|raw|none>  image format of the headless frames, none skips writing them (default png)\n"
+              << "  --load-snapshot <file>   start from a snapshot instead of a new cloth\n"
+              << "  --save-snapshot <file>   write a snapshot of the cloth when the program ends\n"
+              << "  --record <file>          record the positions of every simulated frame\n"
+              << "  --record-precision <u>   quantization step of recorded positions in world units (default 0.01)\n"
+              << "  --play <file>            show a recording instead of simulating\n"
+              << "  --record-input <file>    record mouse input and time steps\n"
+              << "  --replay-input <file>    replay recorded mouse input and time steps instead of live input\n"
+              << "  --mesh <file>            build the cloth from an OBJ or PLY triangle mesh instead of a grid\n"
+              << "  --pin <fraction>         fraction of the mesh height at the top that is fixed (default 0.02)\n"
+              << "  --asset-cache <dir|none> directory imported meshes are cached in, none disables the cache (default cache)\n"
+              << "  --checkpoint <file>      periodically save a checkpoint in headless mode\n"
+              << "  --checkpoint-every <n>   number of frames between checkpoints (default 600)\n"
+              << "  --resume <file>          continue a headless run from a checkpoint\n"
+              << "  --profile <file>         time every phase of a frame and write the histograms as CSV, or JSON for a .json file\n"
+              << "  --profile-every <n>      number of frames between profile updates (default 600)\n"
+              << "  --trace <file>           write a timeline of every thread in the Chrome trace event format\n"
+              << "  --benchmark <samples>    time the solver without rendering and report hardware counters\n"
+              << "  --benchmark-steps <n>    number of steps per benchmark sample (default 50)\n"
+              << "  --benchmark-output <f>   write the benchmark samples and counters as JSON\n"
+              << "  --baseline-dir <dir>     directory with one benchmark baseline per machine class (default baselines)\n"
+              << "  --machine-class <name>   baseline to use instead of the one named after this machine's CPU\n"
+              << "  --save-baseline          store the benchmark as the baseline of this machine class\n"
+              << "  --compare-baseline       compare the benchmark with the baseline and exit with 1 on a regression\n"
+              << "  --regression-threshold <percent>  slowdown of the median that counts as a regression (default 5)\n"
+              << "  --write-golden <file>    run the scenario without rendering and store its state hashes\n"
+              << "  --verify-golden <file>   repeat the run a golden file was written from and exit with 1 if a hash differs\n"
+              << "  --hash-every <n>         number of frames between state hashes (default 10)\n"
+              << "  --determinism-check      run the scenario with every solver configuration and compare the results\n"
+              << "  --tolerance <units>      largest final position difference the determinism check accepts (default 0)\n"
+              << "  --threads <n>            number of threads the solver runs on, results do not depend on it (default all cores)\n"
+              << "  --colliders <file>       planes, spheres, capsules, boxes and meshes the cloth collides with, one per line" << std::endl;
+}
+
+/**
+ * @brief Parses the command line arguments into options
+ * 
+ * @return false if the arguments are invalid
+ */
+bool parseOptions(int argc, char * argv[], Options & options) {
+    for (int i = 1; i < argc; ++i) {
+        const char * arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(arg, "--headless") == 0) {
+            options.headless = true;
+        }
+        else if (std::strcmp(arg, "--frames") == 0 && hasValue) {
+            options.frames = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(arg, "--dt") == 0 && hasValue) {
+            options.dt = std::atof(argv[++i]);
+        }
+        else if (std::strcmp(arg, "--output") == 0 && hasValue) {
+            options.outputDirectory = argv[++i];
+        }
+        else if (std::strcmp(arg, "--format") == 0 && hasValue) {
+            std::string format = argv[++i];
+            if (format == "png") options.format = ImageFormat::PNG;
+            else if (format == "raw") options.format = ImageFormat::Raw;
+            else if (format == "none") options.writeFrames = false;
+            else return false;
+        }
+        else if (std::strcmp(arg, "--load-snapshot") == 0 && hasValue) {
+            options.loadSnapshot = argv[++i];
+        }
+        else if (std::strcmp(arg, "--save-snapshot") == 0 && hasValue) {
+            options.saveSnapshot = argv[++i];
+        }
+        else if (std::strcmp(arg, "--record") == 0 && hasValue) {
+            options.recordPath = argv[++i];
+        }
+        else if (std::strcmp(arg, "--record-precision") == 0 && hasValue) {
+            options.recordPrecision = std::atof(argv[++i]);
+            if (options.recordPrecision <= 0) return false;
+        }
+        else if (std::strcmp(arg, "--play") == 0 && hasValue) {
+            options.playbackPath = argv[++i];
+        }
+        else if (std::strcmp(arg, "--record-input") == 0 && hasValue) {
+            options.recordInputPath = argv[++i];
+        }
+        else if (std::strcmp(arg, "--replay-input") == 0 && hasValue) {
+            options.replayInputPath = argv[++i];
+        }
+        else if (std::strcmp(arg, "--mesh") == 0 && hasValue) {
+            options.meshPath = argv[++i];
+        }
+        else if (std::strcmp(arg, "--pin") == 0 && hasValue) {
+            options.pinFraction = std::atof(argv[++i]);
+            if (options.pinFraction < 0) return false;
+        }
+        else if (std::strcmp(arg, "--asset-cache") == 0 && hasValue) {
+            options.assetCache = argv[++i];
+            if (options.assetCache == "none") options.assetCache.clear();
+        }
+        else if (std::strcmp(arg, "--checkpoint") == 0 && hasValue) {
+            options.checkpointPath = argv[++i];
+        }
+        else if (std::strcmp(arg, "--checkpoint-every") == 0 && hasValue) {
+            options.checkpointInterval = std::atoi(argv[++i]);
+            if (options.checkpointInterval <= 0) return false;
+        }
+        else if (std::strcmp(arg, "--resume") == 0 && hasValue) {
+            options.resumePath = argv[++i];
+        }
+        else if (std::strcmp(arg, "--profile") == 0 && hasValue) {
+            options.profilePath = argv[++i];
+        }
+        else if (std::strcmp(arg, "--profile-every") == 0 && hasValue) {
+            options.profileInterval = std::atoi(argv[++i]);
+            if (options.profileInterval <= 0) return false;
+        }
+        else if (std::strcmp(arg, "--trace") == 0 && hasValue) {
+            options.tracePath = argv[++i];
+        }
+        else if (std::strcmp(arg, "--benchmark") == 0 && hasValue) {
+            options.benchmarkSamples = std::atoi(argv[++i]);
+            if (options.benchmarkSamples <= 0) return false;
+        }
+        else if (std::strcmp(arg, "--benchmark-steps") == 0 && hasValue) {
+            options.benchmarkSteps = std::atoi(argv[++i]);
+            if (options.benchmarkSteps <= 0) return false;
+        }
+        else if (std::strcmp(arg, "--benchmark-output") == 0 && hasValue) {
+            options.benchmarkOutput = argv[++i];
+        }
+        else if (std::strcmp(arg, "--baseline-dir") == 0 && hasValue) {
+            options.baselineDirectory = argv[++i];
+        }
+        else if (std::strcmp(arg, "--machine-class") == 0 && hasValue) {
+            options.machineClass = argv[++i];
+        }
+        else if (std::strcmp(arg, "--save-baseline") == 0) {
+            options.saveBaseline = true;
+        }
+        else if (std::strcmp(arg, "--compare-baseline") == 0) {
+            options.compareBaseline = true;
+        }
+        else if (std::strcmp(arg, "--regression-threshold") == 0 && hasValue) {
+            options.regressionThreshold = std::atof(argv[++i]);
+        }
+        else if (std::strcmp(arg, "--write-golden") == 0 && hasValue) {
+            options.writeGoldenPath = argv[++i];
+        }
+        else if (std::strcmp(arg, "--verify-golden") == 0 && hasValue) {
+            options.verifyGoldenPath = argv[++i];
+        }
+        else if (std::strcmp(arg, "--hash-every") == 0 && hasValue) {
+            options.hashInterval = std::atoi(argv[++i]);
+            if (options.hashInterval <= 0) return false;
+        }
+        else if (std::strcmp(arg, "--determinism-check") == 0) {
+            options.determinismCheck = true;
+        }
+        else if (std::strcmp(arg, "--tolerance") == 0 && hasValue) {
+            options.tolerance = std::atof(argv[++i]);
+        }
+        else if (std::strcmp(arg, "--threads") == 0 && hasValue) {
+            options.threads = std::atoi(argv[++i]);
+            if (options.threads <= 0) return false;
+        }
+        else if (std::strcmp(arg, "--colliders") == 0 && hasValue) {
+            options.collidersPath = argv[++i];
+        }
+        else {
+            return false;
+        }
+    }
+    return options.frames >= 0 && options.dt > 0;
+}
+
+// Sets up an orthographic projection where one unit is one pixel and y points down
+void setupProjection(int width, int height) {
+    glEnable(GL_DEPTH_TEST);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    // The depth range is wide enough for meshes that are scaled to fit the screen
+    glOrtho(0, width, height,0, -10000, 10000);
+}
+
+/**
+ * @brief Scales a mesh uniformly so that it fits in the upper middle of the screen and hangs from the top.
+ * Meshes are usually modelled with y pointing up, so y is flipped to match the screen
+ * 
+ * @param meshHeight receives the height of the placed mesh
+ * @return false if the mesh has no vertices
+ */
+bool placeMesh(MeshData & mesh, int width, int height, float & meshHeight) {
+    if (mesh.positions.empty()) {
+        std::cerr << "The mesh has no vertices" << std::endl;
+        return false;
+    }
+    glm::fvec3 low = mesh.positions[0];
+    glm::fvec3 high = mesh.positions[0];
+    for (const glm::fvec3 & position : mesh.positions) {
+        low = glm::min(low, position);
+        high = glm::max(high, position);
+    }
+    glm::fvec3 size = high - low;
+    float scale = std::min(width * 0.5f / std::max(size.x, 1e-6f), height * 0.6f / std::max(size.y, 1e-6f));
+    glm::fvec3 center = (low + high) * 0.5f;
+    for (glm::fvec3 & position : mesh.positions) {
+        position = glm::fvec3((position.x - center.x) * scale + width * 0.5f,
+                              (high.y - position.y) * scale + height * 0.05f,
+                              (position.z - center.z) * scale);
+    }
+    meshHeight = size.y * scale;
+    return true;
+}
+
+/**
+ * @brief Builds the cloth from the mesh given on the command line. The result is kept in the asset cache,
+ * so later runs with the same mesh and settings map the cached cloth instead of importing the mesh again
+ * 
+ * @return false if the mesh cannot be loaded
+ */
+bool loadMeshCloth(const Options & options, int width, int height, Cloth & cloth) {
+    std::unique_ptr<AssetCache> cache;
+    uint64_t key = 0;
+    if (!options.assetCache.empty()) {
+        std::shared_ptr<MappedFile> source = MappedFile::open(options.meshPath);
+        if (!source) return false;
+
+        // Everything the imported cloth depends on besides the mesh itself
+        struct {
+            int32_t width;
+            int32_t height;
+            float pinFraction;
+            uint32_t version;
+            uint32_t vertexSize;
+            uint32_t constraintSize;
+        } settings = { width, height, options.pinFraction, snapshotVersion, sizeof(Vertex), sizeof(Constraint) };
+        cache.reset(new AssetCache(options.assetCache));
+        key = AssetCache::hash(source->data(), source->size(), AssetCache::hash(&settings, sizeof(settings)));
+        if (cache->contains(key) && cloth.loadSnapshot(cache->pathFor(key), nullptr, false)) return true;
+    }
+
+    MeshData mesh;
+    if (!loadMesh(options.meshPath, mesh)) return false;
+    float meshHeight = 0;
+    if (!placeMesh(mesh, width, height, meshHeight)) return false;
+    cloth = Cloth(mesh, meshHeight * options.pinFraction);
+
+    // A cache that cannot be written only costs the next start its speed
+    if (cache && cache->prepare()) cloth.saveSnapshot(cache->pathFor(key));
+    return true;
+}
+
+/*
+Where new frames come from: either the simulation, optionally recorded, or a recording being played back.
+Mouse input for the simulation comes from the window or from an input replay, and can be recorded
+*/
+struct FrameSource {
+    std::unique_ptr<FrameRecorder> recorder;
+    std::unique_ptr<RecordingReader> playback;
+    std::unique_ptr<InputRecorder> inputRecorder;
+    std::unique_ptr<InputReplay> inputReplay;
+    RecordedFrame playbackFrame;
+    // Compactions since the last recorded frame, which the next frame that is not dropped carries
+    std::vector<std::vector<uint32_t>> pendingCompactions;
+    bool finished = false;
+
+    bool open(const Options & options) {
+        if (!options.recordInputPath.empty()) {
+            inputRecorder.reset(new InputRecorder(options.recordInputPath));
+            if (!inputRecorder->isOpen()) return false;
+        }
+        if (!options.replayInputPath.empty()) {
+            inputReplay.reset(new InputReplay());
+            if (!inputReplay->load(options.replayInputPath)) return false;
+        }
+        if (!options.playbackPath.empty()) {
+            playback.reset(new RecordingReader());
+            if (!playback->open(options.playbackPath)) return false;
+        }
+        else if (!options.recordPath.empty()) {
+            recorder.reset(new FrameRecorder(options.recordPath, options.recordPrecision));
+            if (!recorder->isOpen()) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Advances the cloth by one frame
+     * 
+     * @return false once a played back recording has ended
+     */
+    bool advance(Cloth & cloth, float dt) {
+        if (finished) return false;
+        if (playback) {
+            if (!playback->next(playbackFrame) ||
+                !cloth.setState(playbackFrame.positions, playbackFrame.destroyed, playbackFrame.compactions)) {
+                finished = true;
+                return false;
+            }
+            return true;
+        }
+
+        // Replayed events are applied once the simulation reaches the step they were recorded at,
+        // up to the recorded time step of the next simulated step
+        if (inputReplay) {
+            InputEvent event;
+            while (inputReplay->poll(cloth.getStep(), event)) {
+                if (event.type == InputEventType::Step) {
+                    dt = event.dt;
+                    break;
+                }
+                if (inputRecorder) inputRecorder->record(event);
+                applyInput(cloth, event);
+            }
+            // A sleeping cloth does not step, so events recorded at later steps would never arrive. In a recording
+            // of this same run the cloth was awake at those steps, while replays that start from a settled snapshot
+            // or pause for longer than the cloth takes to fall asleep need it woken
+            if (cloth.isAsleep() && inputReplay->waitingFor(cloth.getStep())) cloth.wake();
+        }
+
+        uint32_t step = cloth.getStep();
+        if (inputRecorder && !cloth.isAsleep()) {
+            InputEvent event;
+            event.type = InputEventType::Step;
+            event.step = step;
+            event.dt = dt;
+            inputRecorder->record(event);
+        }
+        cloth.update(dt);
+        // A sleeping cloth does not change, so only steps that were simulated are recorded
+        if (recorder && cloth.getStep() != step) {
+            RecordedFrame frame = recorder->acquire();
+            frame.index = cloth.getStep();
+            cloth.copyState(frame.positions, frame.destroyed);
+            frame.compactions = pendingCompactions;
+            if (recorder->submit(std::move(frame))) pendingCompactions.clear();
+        }
+        // The removed vertices are recorded with the next frame, so playback can compact its cloth the same way
+        // even if the frames around the compaction are dropped
+        std::vector<uint32_t> removed;
+        if (cloth.compactIfNeeded(recorder ? &removed : nullptr)) pendingCompactions.push_back(std::move(removed));
+        return true;
+    }
+
+    /**
+     * @brief Saves a checkpoint of the cloth and of how far the input replay has come
+     * 
+     * @param frame the number of frames completed so far
+     * @return false if the checkpoint could not be written
+     */
+    bool saveCheckpoint(const Cloth & cloth, const std::string & path, uint64_t frame) const {
+        // A played back recording has no simulation state to save
+        if (playback) return true;
+        SnapshotRuntimeState runtime;
+        std::memset(&runtime, 0, sizeof(runtime));
+        runtime.frame = frame;
+        runtime.inputEvent = inputReplay ? inputReplay->position() : 0;
+        return cloth.saveSnapshot(path, &runtime);
+    }
+
+    /**
+     * @brief Continues the input replay from where a checkpoint was taken
+     * 
+     * @return false if the checkpoint does not belong to the replayed input
+     */
+    bool resume(const SnapshotRuntimeState & runtime) {
+        if (inputReplay && !inputReplay->seek(runtime.inputEvent)) {
+            std::cerr << "Checkpoint is ahead of the replayed input" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Whether replayed input still has to be applied, which a sleeping cloth must not wait for
+    bool replayingInput() const {
+        return inputReplay && !inputReplay->finished();
+    }
+
+    /**
+     * @brief Handles a live mouse event. Live input is ignored while input is being replayed
+     * 
+     */
+    void handleInput(Cloth & cloth, InputEvent event) {
+        if (inputReplay) return;
+        event.step = cloth.getStep();
+        if (inputRecorder) inputRecorder->record(event);
+        applyInput(cloth, event);
+    }
+};
+
+/*
+The state the window callbacks work on
+*/
+struct WindowState {
+    Cloth * cloth;
+    FrameSource * source;
+};
+
+void cursor_pos_callback(GLFWwindow * window, double xpos, double ypos) {
+    WindowState * state = static_cast<WindowState *>(glfwGetWindowUserPointer(window));
+    InputEvent event;
+    event.type = InputEventType::CursorMove;
+    event.x = xpos;
+    event.y = ypos;
+    state->source->handleInput(*state->cloth, event);
+}
+
+void window_refresh_callback(GLFWwindow * window) {
+    WindowState * state = static_cast<WindowState *>(glfwGetWindowUserPointer(window));
+    // Redraw when the window is exposed or resized, since nothing else redraws an idle cloth
+    state->cloth->draw();
+    glfwSwapBuffers(window);
+}
+
+void mouse_button_callback(GLFWwindow * window, int button, int action, int mods) {
+    WindowState * state = static_cast<WindowState *>(glfwGetWindowUserPointer(window));
+    if (action != GLFW_PRESS && action != GLFW_RELEASE) return;
+    InputEvent event;
+    event.type = action == GLFW_PRESS ? InputEventType::ButtonPress : InputEventType::ButtonRelease;
+    event.button = button;
+    glfwGetCursorPos(window, &event.x, &event.y);
+    state->source->handleInput(*state->cloth, event);
+}
+
+/**
+ * @brief Creates the cloth the options ask for: resumed from a checkpoint, loaded from a snapshot, built from a mesh or the default grid
+ * 
+ * @param runtime receives the state of a resumed run, or zeros
+ * @return false if the cloth cannot be loaded
+ */
+bool createCloth(const Options & options, int width, int height, Cloth & cloth, SnapshotRuntimeState & runtime) {
+    int rows = 60;
+    int cols = 100;
+    float segmentLength = 10;
+
+    std::memset(&runtime, 0, sizeof(runtime));
+    bool created = true;
+    if (!options.resumePath.empty()) {
+        created = cloth.loadSnapshot(options.resumePath, &runtime);
+    }
+    else if (!options.loadSnapshot.empty()) {
+        created = cloth.loadSnapshot(options.loadSnapshot);
+    }
+    else if (!options.meshPath.empty()) {
+        created = loadMeshCloth(options, width, height, cloth);
+    }
+    else {
+        cloth = Cloth(glm::fvec3(500, 0, 0), segmentLength,rows, cols);
+    }
+    cloth.setSolverThreads(options.threads);
+    if (!options.collidersPath.empty()) {
+        std::vector<Collider> colliders;
+        std::vector<MeshCollider> meshes;
+        if (!loadColliders(options.collidersPath, colliders, meshes)) return false;
+        cloth.setColliders(std::move(colliders), std::move(meshes));
+    }
+    // y points down, so fragments that fall out of the bottom of the window never come back
+    cloth.setCullHeight(height);
+    return created;
+}
+
+/*
+The state hashes of a scenario run and the state it ended in
+*/
+struct ScenarioRun {
+    std::vector<std::pair<uint32_t, uint64_t>> hashes;
+    std::vector<glm::fvec3> positions;
+    std::vector<uint8_t> destroyed;
+};
+
+/**
+ * @brief Simulates the scenario given by the options without rendering or recording, hashing the state after every hashInterval frames
+ * 
+ * @param checkpointFrame if not 0, a checkpoint is saved to checkpointPath after this many frames and the run continues
+ * from a fresh cloth resumed from it, so the hashes show whether resuming reproduces the uninterrupted run
+ * @return false if the scenario cannot be set up
+ */
+bool runScenario(const Options & options, int width, int height, int frames, float dt, int hashInterval, ScenarioRun & run,
+                 int checkpointFrame = 0, const std::string & checkpointPath = std::string()) {
+    Options scenario = options;
+    scenario.recordPath.clear();
+    scenario.recordInputPath.clear();
+    scenario.playbackPath.clear();
+    scenario.resumePath.clear();
+
+    Cloth cloth;
+    SnapshotRuntimeState runtime;
+    std::unique_ptr<FrameSource> source(new FrameSource());
+    if (!createCloth(scenario, width, height, cloth, runtime) || !source->open(scenario) || !source->resume(runtime)) return false;
+
+    for (int frame = 0; frame < frames; ++frame) {
+        source->advance(cloth, dt);
+        if ((frame + 1) % hashInterval == 0) run.hashes.push_back({ frame + 1, cloth.stateHash() });
+        if (frame + 1 != checkpointFrame) continue;
+
+        if (!source->saveCheckpoint(cloth, checkpointPath, frame + 1)) return false;
+        scenario.resumePath = checkpointPath;
+        cloth = Cloth();
+        source.reset(new FrameSource());
+        if (!createCloth(scenario, width, height, cloth, runtime) || !source->open(scenario) || !source->resume(runtime)) return false;
+    }
+    cloth.copyState(run.positions, run.destroyed);
+    return true;
+}
+
+/**
+ * @brief Writes the state hashes of the scenario to a golden file, or checks that they match an existing one
+ * 
+ * @return the exit code of the program, 1 if the hashes do not match
+ */
+int runGolden(const Options & options, int width, int height) {
+    GoldenHashes golden;
+    bool verify = !options.verifyGoldenPath.empty();
+    if (verify && !golden.load(options.verifyGoldenPath)) return -1;
+    if (!verify) {
+        golden.dt = options.dt;
+        golden.frames = options.frames;
+        golden.every = options.hashInterval;
+    }
+
+    ScenarioRun run;
+    if (!runScenario(options, width, height, golden.frames, golden.dt, golden.every, run)) return -1;
+    if (!verify) {
+        golden.hashes = run.hashes;
+        return golden.save(options.writeGoldenPath) ? 0 : -1;
+    }
+
+    for (size_t i = 0; i < golden.hashes.size(); ++i) {
+        if (i >= run.hashes.size() || run.hashes[i] != golden.hashes[i]) {
+            std::printf("Golden mismatch at frame %u of %s\n", golden.hashes[i].first, options.verifyGoldenPath.c_str());
+            return 1;
+        }
+    }
+    std::printf("All %zu golden hashes match\n", golden.hashes.size());
+    return 0;
+}
+
+/**
+ * @brief Runs the scenario once for every solver configuration and checks that all runs agree with the first,
+ * either bit for bit or with final positions within the given tolerance
+ * 
+ * @return the exit code of the program, 1 if a configuration disagrees
+ */
+int runDeterminismCheck(const Options & options, int width, int height) {
+    // The reference runs on one thread and is repeated on it, which catches dependence on uninitialized
+    // memory, the wall clock or state left over from an earlier run. The other thread counts include
+    // ones that do not divide the number of chunks
+    // The last configuration is interrupted halfway by a checkpoint and resumed from it
+    std::vector<int> threadCounts = { 1, 1, 2, 3, 4, 7, options.threads, options.threads };
+    std::vector<std::string> configurations;
+    for (size_t c = 0; c < threadCounts.size(); ++c) {
+        configurations.push_back(c == 1 ? "repeat" : c + 1 == threadCounts.size() ? "resume" :
+                                 std::to_string(threadCounts[c]) + (threadCounts[c] == 1 ? " thread" : " threads"));
+    }
+    std::error_code error;
+    std::string checkpointPath = (std::filesystem::temp_directory_path(error) / "cloth-determinism-check.snap").string();
+    ScenarioRun reference;
+    bool failed = false;
+    for (size_t c = 0; c < configurations.size(); ++c) {
+        Options configuration = options;
+        configuration.threads = threadCounts[c];
+        ScenarioRun run;
+        int checkpointFrame = c + 1 == configurations.size() ? options.frames / 2 : 0;
+        bool ran = runScenario(configuration, width, height, options.frames, options.dt, options.hashInterval, run, checkpointFrame, checkpointPath);
+        if (checkpointFrame > 0) std::remove(checkpointPath.c_str());
+        if (!ran) return -1;
+        if (c == 0) {
+            reference = std::move(run);
+            continue;
+        }
+        if (run.hashes == reference.hashes) {
+            std::printf("%-12s bit-identical\n", configurations[c].c_str());
+            continue;
+        }
+
+        size_t firstDifference = 0;
+        while (run.hashes[firstDifference] == reference.hashes[firstDifference]) ++firstDifference;
+        bool sameTopology = run.destroyed == reference.destroyed;
+        float deviation = 0;
+        for (size_t i = 0; i < run.positions.size() && sameTopology; ++i) {
+            glm::fvec3 delta = glm::abs(run.positions[i] - reference.positions[i]);
+            deviation = std::max({ deviation, delta.x, delta.y, delta.z });
+        }
+        bool within = sameTopology && deviation <= options.tolerance;
+        failed = failed || !within;
+        std::printf("%-12s differs from frame %u, ", configurations[c].c_str(), reference.hashes[firstDifference].first);
+        if (!sameTopology) std::printf("different vertices were destroyed\n");
+        else std::printf("final positions deviate by %g, %s tolerance\n", deviation, within ? "within" : "beyond");
+    }
+    return failed ? 1 : 0;
+}
+
+/**
+ * @brief Times a benchmark step in samples of a fixed number of steps, after one untimed sample to warm up the caches
+ * 
+ * @param step called once per step
+ */
+template <typename F>
+BenchmarkResult measure(const char * name, const Options & options, const Cloth & cloth, PerfCounters & counters, F && step) {
+    BenchmarkResult result;
+    result.name = name;
+    result.particles = cloth.vertexCount();
+    result.stepsPerSample = options.benchmarkSteps;
+    for (int i = 0; i < options.benchmarkSteps; ++i) step();
+
+    for (int c = 0; c < static_cast<int>(Counter::Count); ++c) result.counters.available[c] = true;
+    for (int sample = 0; sample < options.benchmarkSamples; ++sample) {
+        counters.start();
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < options.benchmarkSteps; ++i) step();
+        auto end = std::chrono::steady_clock::now();
+        CounterValues values = counters.stop();
+
+        result.nanosecondsPerStep.push_back(std::chrono::duration<double, std::nano>(end - begin).count() / options.benchmarkSteps);
+        result.steps += options.benchmarkSteps;
+        for (int c = 0; c < static_cast<int>(Counter::Count); ++c) {
+            result.counters.values[c] += values.values[c];
+            result.counters.available[c] = result.counters.available[c] && values.available[c];
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Benchmarks the simulation without rendering: whole steps including replayed input, and single
+ * constraint iterations. Reports the median wall time and the hardware counters per step and per particle.
+ * Page faults are a software counter and show whether a mapped snapshot is still being paged in
+ * 
+ * @return the exit code of the program
+ */
+int runBenchmark(const Options & options, Cloth & cloth, FrameSource & source) {
+    PerfCounters counters;
+    if (!counters.hasHardwareCounters()) {
+        std::cerr << "Hardware performance counters are not available, only wall time is reported" << std::endl;
+    }
+
+    // The cloth is kept awake, otherwise a settled cloth would be timed doing nothing
+    std::vector<BenchmarkResult> results;
+    results.push_back(measure("update", options, cloth, counters, [&] {
+        cloth.wake();
+        source.advance(cloth, options.dt);
+    }));
+    results.push_back(measure("satisfy_constraints", options, cloth, counters, [&] {
+        cloth.satisfyConstraints();
+    }));
+
+    double particles = std::max<size_t>(cloth.vertexCount(), 1);
+    std::printf("%-20s %12s %12s %8s %14s %14s %16s %12s\n", "benchmark", "ns/step", "ns/particle", "IPC",
+                "l1d/particle", "llc/particle", "branch/particle", "faults/step");
+    for (BenchmarkResult & result : results) {
+        double median = ::median(result.nanosecondsPerStep);
+
+        auto perParticle = [&](Counter counter) {
+            char text[32] = "n/a";
+            if (result.counters.has(counter)) std::snprintf(text, sizeof(text), "%.3f", result.counters[counter] / (particles * result.steps));
+            return std::string(text);
+        };
+        char ipc[32] = "n/a";
+        if (result.counters.has(Counter::Cycles) && result.counters.has(Counter::Instructions) && result.counters[Counter::Cycles] > 0) {
+            std::snprintf(ipc, sizeof(ipc), "%.2f", static_cast<double>(result.counters[Counter::Instructions]) / result.counters[Counter::Cycles]);
+        }
+        char faults[32] = "n/a";
+        if (result.counters.has(Counter::PageFaults)) {
+            std::snprintf(faults, sizeof(faults), "%.2f", static_cast<double>(result.counters[Counter::PageFaults]) / result.steps);
+        }
+        std::printf("%-20s %12.0f %12.3f %8s %14s %14s %16s %12s\n", result.name.c_str(), median, median / particles, ipc,
+                    perParticle(Counter::L1DataMisses).c_str(), perParticle(Counter::LastLevelMisses).c_str(),
+                    perParticle(Counter::BranchMisses).c_str(), faults);
+    }
+
+    std::string machine = options.machineClass.empty() ? machineClass() : options.machineClass;
+    if (!options.benchmarkOutput.empty() && !writeBenchmarkJSON(options.benchmarkOutput, machine, results)) return -1;
+
+    std::error_code error;
+    std::filesystem::create_directories(options.baselineDirectory, error);
+    std::string baselinePath = (std::filesystem::path(options.baselineDirectory) / (machine + ".txt")).string();
+    if (options.saveBaseline) {
+        if (!BenchmarkBaseline::save(baselinePath, machine, results)) return -1;
+        std::printf("Saved baseline %s\n", baselinePath.c_str());
+        return 0;
+    }
+    if (!options.compareBaseline) return 0;
+
+    // A regression needs both a significant shift and a slowdown of the median beyond the threshold,
+    // so neither noise nor a tiny but consistent difference fails the run
+    BenchmarkBaseline baseline;
+    if (!baseline.load(baselinePath)) return -1;
+    const double significance = 0.01;
+    bool regressed = false;
+    for (const BenchmarkResult & result : results) {
+        const BenchmarkResult * reference = baseline.find(result);
+        if (!reference) {
+            std::printf("%-20s no baseline for this workload\n", result.name.c_str());
+            continue;
+        }
+        double change = median(result.nanosecondsPerStep) / median(reference->nanosecondsPerStep) - 1;
+        double p = mannWhitneyGreater(reference->nanosecondsPerStep, result.nanosecondsPerStep);
+        bool regression = p < significance && change * 100 > options.regressionThreshold;
+        regressed = regressed || regression;
+        std::printf("%-20s %+7.1f%% median, p = %.4f %s\n", result.name.c_str(), change * 100, p, regression ? "REGRESSION" : "ok");
+    }
+    return regressed ? 1 : 0;
+}
+
+/**
+ * @brief Simulates the cloth with a fixed time step and writes every rendered frame to disk, without creating a window
+ * 
+ * @param firstFrame the frame to start at, which is not 0 when resuming from a checkpoint
+ * @return the exit code of the program
+ */
+int runHeadless(const Options & options, Cloth & cloth, FrameSource & source, int firstFrame, int width, int height) {
+    HeadlessContext context;
+    if (!context.create(width, height)) return -1;
+    setupProjection(width, height);
+
+    std::unique_ptr<FrameWriter> writer;
+    if (options.writeFrames) writer.reset(new FrameWriter(options.outputDirectory, options.format));
+
+    for (int frame = firstFrame; frame < options.frames; ++frame) {
+        ScopedTimer timer(Phase::Frame);
+        cloth.draw();
+
+        if (writer) {
+            Frame image;
+            image.index = frame;
+            image.width = width;
+            image.height = height;
+            image.pixels.resize(static_cast<size_t>(width) * height * 3);
+            ScopedTimer readbackTimer(Phase::Readback);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, image.pixels.data());
+            writer->submit(std::move(image));
+        }
+
+        if (!source.advance(cloth, options.dt)) break;
+
+        // A failed checkpoint is reported but does not stop the run, the previous one stays valid
+        if (!options.checkpointPath.empty() && (frame + 1) % options.checkpointInterval == 0) {
+            source.saveCheckpoint(cloth, options.checkpointPath, frame + 1);
+        }
+        if (!options.profilePath.empty() && (frame + 1) % options.profileInterval == 0) {
+            Profiler::instance().dump(options.profilePath);
+        }
+    }
+
+    if (writer) {
+        writer->finish();
+        if (writer->failedFrames() > 0) {
+            std::cerr << writer->failedFrames() << " frames could not be written" << std::endl;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char * argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    int width = 2000;
+    int height = 1500;
+
+    if (!options.writeGoldenPath.empty() || !options.verifyGoldenPath.empty()) {
+        return runGolden(options, width, height);
+    }
+    if (options.determinismCheck) {
+        return runDeterminismCheck(options, width, height);
+    }
+
+    Cloth cloth;
+    SnapshotRuntimeState runtime;
+    if (!createCloth(options, width, height, cloth, runtime)) return -1;
+
+    if (!options.profilePath.empty()) Profiler::instance().setEnabled(true);
+    if (!options.tracePath.empty()) {
+        if (!Tracer::instance().start(options.tracePath)) return -1;
+        Tracer::instance().nameThread("simulation");
+    }
+
+    FrameSource source;
+    if (!source.open(options) || !source.resume(runtime)) return -1;
+
+    if (options.benchmarkSamples > 0) {
+        return runBenchmark(options, cloth, source);
+    }
+
+    if (options.headless) {
+        int result = runHeadless(options, cloth, source, runtime.frame, width, height);
+        if (!options.profilePath.empty() && !Profiler::instance().dump(options.profilePath)) result = -1;
+        Tracer::instance().stop();
+        if (result == 0 && !options.saveSnapshot.empty() && !cloth.saveSnapshot(options.saveSnapshot)) result = -1;
+        return result;
+    }
+
+    if (!glfwInit()) {
+        std::cerr << "Could not initialize GLFW" << std::endl;
+        return -1;
+    }
+
+    GLFWwindow * window = glfwCreateWindow(width, height, "Cloth Simulation", NULL, NULL);
+    if (!window) {
+        std::cerr << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    
+    glfwMakeContextCurrent(window);
+
+    setupProjection(width, height);
+
+    // Set callbacks for mouse events
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetCursorPosCallback(window, cursor_pos_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
+
+    WindowState state{ &cloth, &source };
+    glfwSetWindowUserPointer(window, &state);
+
+    double lastUpdateTime = glfwGetTime();
+    float dt = 0;
+    int frame = 0;
+    
+    while (!glfwWindowShouldClose(window)) {
+        // While the cloth is at rest there is nothing new to draw, so block until an event arrives.
+        // The timeout only bounds how long a close request can go unnoticed
+        if ((cloth.isAsleep() && !source.replayingInput()) || source.finished) {
+            glfwWaitEventsTimeout(0.5);
+            lastUpdateTime = glfwGetTime();
+            continue;
+        }
+
+        // Calculate the time since the last update (deltaTime dt)
+        dt = glfwGetTime() - lastUpdateTime;
+        lastUpdateTime = glfwGetTime();
+        {
+            ScopedTimer timer(Phase::Frame);
+            cloth.draw();
+            {
+                ScopedTimer swapTimer(Phase::SwapBuffers);
+                glfwSwapBuffers(window);
+            }
+            source.advance(cloth, dt);
+            ScopedTimer pollTimer(Phase::PollEvents);
+            glfwPollEvents();
+        }
+        if (!options.profilePath.empty() && ++frame % options.profileInterval == 0) {
+            Profiler::instance().dump(options.profilePath);
+        }
+    }
+    
+    glfwTerminate();    
+
+    if (!options.profilePath.empty()) Profiler::instance().dump(options.profilePath);
+    Tracer::instance().stop();
+
+    if (!options.saveSnapshot.empty() && !cloth.saveSnapshot(options.saveSnapshot)) return -1;
     return 0;
 }
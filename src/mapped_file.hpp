@@ -0,0 +1,98 @@
+/**
+ * @file mapped_file.hpp
+ * @brief Maps a file into memory so its contents can be used in place
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+A private, writable mapping of a whole file. Writes go to copy-on-write pages and never reach
+the file, so the contents can be modified in place by the simulation. On platforms without
+mmap the file is read into memory instead.
+*/
+class MappedFile {
+    unsigned char * address = nullptr;
+    std::size_t length = 0;
+    std::vector<unsigned char> fallback;
+
+    MappedFile() = default;
+
+public:
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (address != nullptr && fallback.empty()) munmap(address, length);
+#endif
+    }
+
+    /**
+     * @brief Maps the file at the given path
+     *
+     * @param path the file to map
+     * @return the mapping, or nullptr if the file could not be opened or mapped
+     */
+    static std::shared_ptr<MappedFile> open(const std::string & path) {
+        std::shared_ptr<MappedFile> file(new MappedFile());
+#if defined(__unix__) || defined(__APPLE__)
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            std::cerr << "Could not open " << path << std::endl;
+            return nullptr;
+        }
+        struct stat info;
+        if (fstat(descriptor, &info) != 0 || info.st_size == 0) {
+            std::cerr << "Could not map empty file " << path << std::endl;
+            ::close(descriptor);
+            return nullptr;
+        }
+        file->length = info.st_size;
+        void * address = mmap(nullptr, file->length, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0);
+        ::close(descriptor);
+        if (address == MAP_FAILED) {
+            std::cerr << "Could not map " << path << std::endl;
+            return nullptr;
+        }
+        file->address = static_cast<unsigned char *>(address);
+#else
+        std::ifstream stream(path, std::ios::binary);
+        if (!stream) {
+            std::cerr << "Could not open " << path << std::endl;
+            return nullptr;
+        }
+        file->fallback.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        if (file->fallback.empty()) return nullptr;
+        file->address = file->fallback.data();
+        file->length = file->fallback.size();
+#endif
+        return file;
+    }
+
+    unsigned char * data() {
+        return address;
+    }
+
+    const unsigned char * data() const {
+        return address;
+    }
+
+    std::size_t size() const {
+        return length;
+    }
+};
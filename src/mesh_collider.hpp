@@ -0,0 +1,261 @@
+/**
+ * @file mesh_collider.hpp
+ * @brief A triangle mesh that particles cannot pass through, with a bounding volume hierarchy that follows the mesh as it moves
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+#include <glm.hpp>
+#include "mesh_loader.hpp"
+
+/*
+A triangle mesh placed in the world, optionally moving at a constant velocity and spinning about the
+vertical axis through its origin. Its pose is a function of the simulated time only, so a run that is
+resumed from a checkpoint sees the same mesh.
+
+The triangles are kept in a binary bounding volume hierarchy whose nodes are stored parent before
+children, with the two children of a node next to each other. A moving mesh keeps the tree it was
+built with and refits the bounds bottom up after every move, which is much cheaper than rebuilding it.
+
+Particles are tested with their whole path over a step, from where they were to where they are, so a
+fast particle cannot jump through a thin part of the mesh. For a moving mesh the start of the path
+is carried along with the mesh first, which makes the test exact for its rigid motion.
+*/
+class MeshCollider {
+    struct Node {
+        glm::fvec3 low;
+        glm::fvec3 high;
+        // A leaf holds count triangles of order from first on, an inner node has count 0 and its children at first and first + 1
+        uint32_t first;
+        uint32_t count;
+    };
+
+    std::vector<glm::fvec3> rest;
+    std::vector<glm::fvec3> positions;
+    std::vector<uint32_t> triangles;
+    std::vector<uint32_t> order;
+    std::vector<Node> nodes;
+    glm::fvec3 origin = glm::fvec3(0);
+    glm::fvec3 velocity = glm::fvec3(0);
+    float spin = 0;
+    double posedTime = 0;
+
+    static const uint32_t leafSize = 4;
+
+    void triangleBounds(uint32_t triangle, glm::fvec3 & low, glm::fvec3 & high) const {
+        const glm::fvec3 & a = positions[triangles[triangle * 3]];
+        const glm::fvec3 & b = positions[triangles[triangle * 3 + 1]];
+        const glm::fvec3 & c = positions[triangles[triangle * 3 + 2]];
+        low = glm::min(glm::min(a, b), c) - thickness;
+        high = glm::max(glm::max(a, b), c) + thickness;
+    }
+
+    void leafBounds(Node & node) const {
+        node.low = glm::fvec3(std::numeric_limits<float>::max());
+        node.high = glm::fvec3(-std::numeric_limits<float>::max());
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            glm::fvec3 low, high;
+            triangleBounds(order[i], low, high);
+            node.low = glm::min(node.low, low);
+            node.high = glm::max(node.high, high);
+        }
+    }
+
+    // Splits the triangles order[first, first + count) at the median centroid along the longest axis of their centroids
+    void build(uint32_t node, uint32_t first, uint32_t count) {
+        nodes[node].first = first;
+        nodes[node].count = count;
+        leafBounds(nodes[node]);
+        if (count <= leafSize) return;
+
+        auto centroid = [&](uint32_t triangle) {
+            return positions[triangles[triangle * 3]] + positions[triangles[triangle * 3 + 1]] + positions[triangles[triangle * 3 + 2]];
+        };
+        glm::fvec3 low(std::numeric_limits<float>::max());
+        glm::fvec3 high(-std::numeric_limits<float>::max());
+        for (uint32_t i = first; i < first + count; ++i) {
+            low = glm::min(low, centroid(order[i]));
+            high = glm::max(high, centroid(order[i]));
+        }
+        glm::fvec3 size = high - low;
+        int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+        uint32_t half = count / 2;
+        std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+                         [&](uint32_t a, uint32_t b) { return centroid(a)[axis] < centroid(b)[axis]; });
+
+        uint32_t children = nodes.size();
+        nodes.resize(children + 2);
+        nodes[node].first = children;
+        nodes[node].count = 0;
+        build(children, first, half);
+        build(children + 1, first + half, count - half);
+    }
+
+    glm::fvec3 toWorld(glm::fvec3 local, double time) const {
+        float angle = (float)(spin * time);
+        float c = std::cos(angle), s = std::sin(angle);
+        glm::fvec3 turned(local.x * c + local.z * s, local.y, -local.x * s + local.z * c);
+        return turned + origin + velocity * (float)time;
+    }
+
+    glm::fvec3 toLocal(glm::fvec3 world, double time) const {
+        glm::fvec3 moved = world - origin - velocity * (float)time;
+        float angle = (float)(spin * time);
+        float c = std::cos(angle), s = std::sin(angle);
+        return glm::fvec3(moved.x * c - moved.z * s, moved.y, moved.x * s + moved.z * c);
+    }
+
+public:
+    // Particles are kept this far from the surface, on the side they came from
+    float thickness = 1.0f;
+
+    /**
+     * @brief Loads an OBJ or PLY mesh. Meshes have y pointing up, so it is flipped to match the world
+     *
+     * @param path the mesh file
+     * @param position where the origin of the mesh is placed at time 0
+     * @param scale the size of one mesh unit in world units
+     * @param meshVelocity how far the mesh moves per simulated second
+     * @param meshSpin how many radians the mesh turns about the vertical axis through its origin per simulated second
+     * @return false if the mesh cannot be loaded
+     */
+    bool load(const std::string & path, glm::fvec3 position, float scale, glm::fvec3 meshVelocity, float meshSpin) {
+        MeshData mesh;
+        if (!loadMesh(path, mesh)) return false;
+        rest.resize(mesh.positions.size());
+        for (size_t i = 0; i < rest.size(); ++i) rest[i] = mesh.positions[i] * glm::fvec3(scale, -scale, scale);
+        triangles = std::move(mesh.triangles);
+        origin = position;
+        velocity = meshVelocity;
+        spin = meshSpin;
+
+        posedTime = 0;
+        positions.resize(rest.size());
+        for (size_t i = 0; i < rest.size(); ++i) positions[i] = toWorld(rest[i], 0);
+        uint32_t triangleCount = triangles.size() / 3;
+        order.resize(triangleCount);
+        for (uint32_t i = 0; i < triangleCount; ++i) order[i] = i;
+        nodes.assign(1, Node());
+        build(0, 0, triangleCount);
+        return true;
+    }
+
+    bool isMoving() const {
+        return velocity != glm::fvec3(0) || spin != 0;
+    }
+
+    /**
+     * @brief Moves the mesh to where it is at a point in simulated time and refits the hierarchy to it
+     *
+     * @param time the simulated time
+     */
+    void pose(double time) {
+        if (!isMoving() || time == posedTime) return;
+        posedTime = time;
+        for (size_t i = 0; i < rest.size(); ++i) positions[i] = toWorld(rest[i], time);
+        // Children come after their parent, so walking backwards visits both children before the parent
+        for (size_t n = nodes.size(); n-- > 0;) {
+            Node & node = nodes[n];
+            if (node.count > 0) {
+                leafBounds(node);
+                continue;
+            }
+            node.low = glm::min(nodes[node.first].low, nodes[node.first + 1].low);
+            node.high = glm::max(nodes[node.first].high, nodes[node.first + 1].high);
+        }
+    }
+
+    /**
+     * @brief Moves a point along with the mesh from one time to another, as if it were attached to it
+     *
+     * @return the point at time to
+     */
+    glm::fvec3 carry(glm::fvec3 point, double from, double to) const {
+        if (!isMoving()) return point;
+        return toWorld(toLocal(point, from), to);
+    }
+
+    /**
+     * @brief Collects the triangles whose bounds, grown by the thickness, overlap a box
+     *
+     * @param low the smallest coordinates of the box
+     * @param high the largest coordinates of the box
+     * @param found receives the triangle indices, it is cleared first
+     */
+    void query(glm::fvec3 low, glm::fvec3 high, std::vector<uint32_t> & found) const {
+        found.clear();
+        if (nodes.empty()) return;
+        uint32_t stack[64];
+        int depth = 0;
+        stack[depth++] = 0;
+        while (depth > 0) {
+            const Node & node = nodes[stack[--depth]];
+            if (glm::any(glm::lessThan(node.high, low)) || glm::any(glm::lessThan(high, node.low))) continue;
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; ++i) found.push_back(order[i]);
+                continue;
+            }
+            stack[depth++] = node.first;
+            stack[depth++] = node.first + 1;
+        }
+    }
+
+    /**
+     * @brief Finds the first of a set of triangles that the path from start to end crosses, and moves the end of the path
+     * onto the side of that triangle's plane the path started on, thickness away from it. Sliding along the triangle is kept
+     *
+     * @param candidates the triangles to test, from query()
+     * @param start where the path starts, carried along with the mesh
+     * @param end where the path ends, moved if the path crosses a triangle
+     * @return false if the path crosses none of the triangles
+     */
+    bool sweep(const std::vector<uint32_t> & candidates, glm::fvec3 start, glm::fvec3 & end) const {
+        glm::fvec3 low = glm::min(start, end);
+        glm::fvec3 high = glm::max(start, end);
+        glm::fvec3 path = end - start;
+        float first = std::numeric_limits<float>::max();
+        glm::fvec3 normal(0);
+        glm::fvec3 point(0);
+        for (uint32_t triangle : candidates) {
+            glm::fvec3 triangleLow, triangleHigh;
+            triangleBounds(triangle, triangleLow, triangleHigh);
+            if (glm::any(glm::lessThan(triangleHigh, low)) || glm::any(glm::lessThan(high, triangleLow))) continue;
+
+            // Moller-Trumbore intersection of the path with the triangle
+            const glm::fvec3 & a = positions[triangles[triangle * 3]];
+            glm::fvec3 ab = positions[triangles[triangle * 3 + 1]] - a;
+            glm::fvec3 ac = positions[triangles[triangle * 3 + 2]] - a;
+            glm::fvec3 p = glm::cross(path, ac);
+            float determinant = glm::dot(ab, p);
+            if (std::fabs(determinant) < 1e-12f) continue;
+            float inverse = 1.0f / determinant;
+            glm::fvec3 offset = start - a;
+            float u = glm::dot(offset, p) * inverse;
+            if (u < 0.0f || u > 1.0f) continue;
+            glm::fvec3 q = glm::cross(offset, ab);
+            float v = glm::dot(path, q) * inverse;
+            if (v < 0.0f || u + v > 1.0f) continue;
+            float t = glm::dot(ac, q) * inverse;
+            if (t < 0.0f || t > 1.0f || t >= first) continue;
+            first = t;
+            normal = glm::normalize(glm::cross(ab, ac));
+            point = a;
+        }
+        if (first == std::numeric_limits<float>::max()) return false;
+        if (glm::dot(start - point, normal) < 0.0f) normal = -normal;
+        end += normal * (thickness - glm::dot(end - point, normal));
+        return true;
+    }
+
+    size_t triangleCount() const {
+        return triangles.size() / 3;
+    }
+};
@@ -0,0 +1,564 @@
+/**
+ * @file mesh_loader.hpp
+ * @brief Loads triangle meshes from OBJ and PLY files and extracts the edges a cloth is built from
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <glm.hpp>
+#include "mapped_file.hpp"
+
+/*
+A triangle mesh, three vertex indices per triangle
+*/
+struct MeshData {
+    std::vector<glm::fvec3> positions;
+    std::vector<uint32_t> triangles;
+};
+
+/*
+The constraints of a cloth built from a mesh. Edges are the unique triangle edges, bending pairs
+connect the two vertices opposite an edge shared by two triangles. Both are sorted by their first,
+smaller vertex index
+*/
+struct MeshTopology {
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    std::vector<std::pair<uint32_t, uint32_t>> bendingPairs;
+};
+
+/*
+Hand written parsing helpers that work directly on the mapped file. They avoid iostreams and
+strtod, whose locale handling dominates the load time of large meshes.
+*/
+namespace meshparse {
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char * skipSpaces(const char * p, const char * end) {
+    while (p < end && isSpace(*p)) ++p;
+    return p;
+}
+
+inline const char * skipLine(const char * p, const char * end) {
+    const char * newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+    return newline ? newline + 1 : end;
+}
+
+/**
+ * @brief Parses a decimal number with optional sign, fraction and exponent
+ *
+ * @param p the position to parse from, advanced past the number
+ * @param end the end of the input
+ * @param out receives the number
+ * @return false if there is no number at p
+ */
+inline bool parseNumber(const char *& p, const char * end, double & out) {
+    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    const char * s = skipSpaces(p, end);
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) negative = *s++ == '-';
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    for (; s < end && *s >= '0' && *s <= '9'; ++s, ++digits) {
+        if (mantissa < 100000000000000000ull) mantissa = mantissa * 10 + (*s - '0');
+        else ++exponent;
+    }
+    if (s < end && *s == '.') {
+        for (++s; s < end && *s >= '0' && *s <= '9'; ++s, ++digits) {
+            if (mantissa < 100000000000000000ull) {
+                mantissa = mantissa * 10 + (*s - '0');
+                --exponent;
+            }
+        }
+    }
+    if (digits == 0) return false;
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        const char * e = s + 1;
+        bool negativeExponent = false;
+        if (e < end && (*e == '-' || *e == '+')) negativeExponent = *e++ == '-';
+        int value = 0;
+        const char * start = e;
+        for (; e < end && *e >= '0' && *e <= '9'; ++e) value = std::min(value * 10 + (*e - '0'), 10000);
+        if (e != start) {
+            exponent += negativeExponent ? -value : value;
+            s = e;
+        }
+    }
+
+    double value = static_cast<double>(mantissa);
+    while (exponent > 22) {
+        value *= 1e22;
+        exponent -= 22;
+    }
+    while (exponent < -22) {
+        value /= 1e22;
+        exponent += 22;
+    }
+    value = exponent >= 0 ? value * powers[exponent] : value / powers[-exponent];
+    out = negative ? -value : value;
+    p = s;
+    return true;
+}
+
+inline bool parseInteger(const char *& p, const char * end, long & out) {
+    const char * s = skipSpaces(p, end);
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) negative = *s++ == '-';
+    const char * start = s;
+    long value = 0;
+    for (; s < end && *s >= '0' && *s <= '9'; ++s) value = value * 10 + (*s - '0');
+    if (s == start) return false;
+    out = negative ? -value : value;
+    p = s;
+    return true;
+}
+
+}
+
+/**
+ * @brief Parses a Wavefront OBJ file. Only vertex positions and faces are read, polygons are split into triangle fans
+ *
+ * @return false if the file is malformed
+ */
+inline bool loadOBJ(const MappedFile & file, MeshData & mesh) {
+    const char * p = reinterpret_cast<const char *>(file.data());
+    const char * end = p + file.size();
+    std::vector<long> polygon;
+    int line = 0;
+    while (p < end) {
+        ++line;
+        const char * s = meshparse::skipSpaces(p, end);
+        if (s + 1 < end && s[0] == 'v' && meshparse::isSpace(s[1])) {
+            double x, y, z;
+            s += 1;
+            if (!meshparse::parseNumber(s, end, x) || !meshparse::parseNumber(s, end, y) || !meshparse::parseNumber(s, end, z)) {
+                std::cerr << "Invalid vertex on line " << line << std::endl;
+                return false;
+            }
+            mesh.positions.push_back(glm::fvec3(x, y, z));
+        }
+        else if (s + 1 < end && s[0] == 'f' && meshparse::isSpace(s[1])) {
+            s += 1;
+            polygon.clear();
+            long index;
+            while (meshparse::parseInteger(s, end, index)) {
+                // Negative indices count back from the last vertex, texture and normal indices are skipped
+                long resolved = index > 0 ? index - 1 : (long)mesh.positions.size() + index;
+                if (index == 0 || resolved < 0 || resolved >= (long)mesh.positions.size()) {
+                    std::cerr << "Face on line " << line << " refers to a missing vertex" << std::endl;
+                    return false;
+                }
+                polygon.push_back(resolved);
+                while (s < end && !meshparse::isSpace(*s) && *s != '\n') ++s;
+            }
+            for (size_t i = 2; i < polygon.size(); ++i) {
+                mesh.triangles.insert(mesh.triangles.end(), { (uint32_t)polygon[0], (uint32_t)polygon[i - 1], (uint32_t)polygon[i] });
+            }
+        }
+        p = meshparse::skipLine(s, end);
+    }
+    return true;
+}
+
+/**
+ * @brief Parses an ASCII or binary PLY file. The vertex element must have x, y and z properties and
+ * the face element a vertex_indices list. Other elements and properties are skipped
+ *
+ * @return false if the file is malformed or uses an unsupported format
+ */
+inline bool loadPLY(const MappedFile & file, MeshData & mesh) {
+    enum Format { Ascii, LittleEndian, BigEndian };
+    struct Property {
+        std::string name;
+        int size = 0;
+        char kind = 'f';
+        bool isList = false;
+        int countSize = 0;
+        char countKind = 'u';
+    };
+    struct Element {
+        std::string name;
+        size_t count = 0;
+        std::vector<Property> properties;
+    };
+
+    // Maps a PLY type name to its size and whether it is a signed integer, unsigned integer or float
+    auto parseType = [](const std::string & type, int & size, char & kind) {
+        static const struct { const char * name; int size; char kind; } types[] = {
+            { "char", 1, 'i' }, { "int8", 1, 'i' }, { "uchar", 1, 'u' }, { "uint8", 1, 'u' },
+            { "short", 2, 'i' }, { "int16", 2, 'i' }, { "ushort", 2, 'u' }, { "uint16", 2, 'u' },
+            { "int", 4, 'i' }, { "int32", 4, 'i' }, { "uint", 4, 'u' }, { "uint32", 4, 'u' },
+            { "float", 4, 'f' }, { "float32", 4, 'f' }, { "double", 8, 'f' }, { "float64", 8, 'f' }
+        };
+        for (const auto & t : types) {
+            if (type == t.name) {
+                size = t.size;
+                kind = t.kind;
+                return true;
+            }
+        }
+        return false;
+    };
+
+    const char * p = reinterpret_cast<const char *>(file.data());
+    const char * end = p + file.size();
+    Format format = Ascii;
+    std::vector<Element> elements;
+    bool headerEnded = false;
+    for (int line = 0; p < end && !headerEnded; ++line) {
+        const char * next = meshparse::skipLine(p, end);
+        std::vector<std::string> words;
+        for (const char * s = p; s < next;) {
+            s = meshparse::skipSpaces(s, next);
+            const char * start = s;
+            while (s < next && !meshparse::isSpace(*s) && *s != '\n') ++s;
+            if (s > start) words.emplace_back(start, s);
+            if (s < next && *s == '\n') break;
+        }
+        p = next;
+        if (line == 0) {
+            if (words.empty() || words[0] != "ply") return false;
+        }
+        else if (words.empty() || words[0] == "comment" || words[0] == "obj_info") {
+            continue;
+        }
+        else if (words[0] == "format" && words.size() >= 2) {
+            if (words[1] == "ascii") format = Ascii;
+            else if (words[1] == "binary_little_endian") format = LittleEndian;
+            else if (words[1] == "binary_big_endian") format = BigEndian;
+            else return false;
+        }
+        else if (words[0] == "element" && words.size() >= 3) {
+            Element element;
+            element.name = words[1];
+            element.count = std::strtoull(words[2].c_str(), nullptr, 10);
+            elements.push_back(element);
+        }
+        else if (words[0] == "property" && !elements.empty()) {
+            Property property;
+            bool valid;
+            if (words.size() >= 5 && words[1] == "list") {
+                property.isList = true;
+                property.name = words[4];
+                valid = parseType(words[2], property.countSize, property.countKind) && parseType(words[3], property.size, property.kind);
+            }
+            else {
+                property.name = words.size() >= 3 ? words[2] : "";
+                valid = words.size() >= 3 && parseType(words[1], property.size, property.kind);
+            }
+            if (!valid) {
+                std::cerr << "Unsupported PLY property on header line " << line + 1 << std::endl;
+                return false;
+            }
+            elements.back().properties.push_back(property);
+        }
+        else if (words[0] == "end_header") {
+            headerEnded = true;
+        }
+    }
+    if (!headerEnded) {
+        std::cerr << "PLY header is not terminated" << std::endl;
+        return false;
+    }
+
+    // Reads one value of the given size and kind as a double
+    bool valid = true;
+    auto readValue = [&](int size, char kind) -> double {
+        if (format == Ascii) {
+            while (p < end && (meshparse::isSpace(*p) || *p == '\n')) ++p;
+            double value = 0;
+            if (!meshparse::parseNumber(p, end, value)) valid = false;
+            return value;
+        }
+        if (end - p < size) {
+            valid = false;
+            return 0;
+        }
+        unsigned char bytes[8];
+        std::memcpy(bytes, p, size);
+        p += size;
+        if (format == BigEndian) std::reverse(bytes, bytes + size);
+        switch (kind == 'f' ? size + 100 : size) {
+        case 104: { float v; std::memcpy(&v, bytes, 4); return v; }
+        case 108: { double v; std::memcpy(&v, bytes, 8); return v; }
+        case 1: return kind == 'i' ? (double)(int8_t)bytes[0] : (double)bytes[0];
+        case 2: { uint16_t v; std::memcpy(&v, bytes, 2); return kind == 'i' ? (double)(int16_t)v : (double)v; }
+        case 4: { uint32_t v; std::memcpy(&v, bytes, 4); return kind == 'i' ? (double)(int32_t)v : (double)v; }
+        }
+        valid = false;
+        return 0;
+    };
+
+    std::vector<uint32_t> polygon;
+    for (const Element & element : elements) {
+        bool isVertex = element.name == "vertex";
+        bool isFace = element.name == "face";
+        for (size_t i = 0; i < element.count && valid; ++i) {
+            glm::fvec3 position(0);
+            for (const Property & property : element.properties) {
+                if (!property.isList) {
+                    double value = readValue(property.size, property.kind);
+                    if (isVertex && property.name == "x") position.x = value;
+                    if (isVertex && property.name == "y") position.y = value;
+                    if (isVertex && property.name == "z") position.z = value;
+                    continue;
+                }
+                size_t count = (size_t)readValue(property.countSize, property.countKind);
+                bool indices = isFace && (property.name == "vertex_indices" || property.name == "vertex_index");
+                polygon.clear();
+                for (size_t k = 0; k < count && valid; ++k) {
+                    double value = readValue(property.size, property.kind);
+                    if (indices) polygon.push_back((uint32_t)value);
+                }
+                for (size_t k = 2; indices && k < polygon.size(); ++k) {
+                    mesh.triangles.insert(mesh.triangles.end(), { polygon[0], polygon[k - 1], polygon[k] });
+                }
+            }
+            if (isVertex) mesh.positions.push_back(position);
+        }
+    }
+    if (!valid) {
+        std::cerr << "PLY data is truncated or malformed" << std::endl;
+        return false;
+    }
+    for (uint32_t index : mesh.triangles) {
+        if (index >= mesh.positions.size()) {
+            std::cerr << "PLY face refers to a missing vertex" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Renumbers the vertices in the order the triangles first use them and drops vertices no triangle uses
+ *
+ */
+inline void reorderByFirstUse(MeshData & mesh) {
+    const uint32_t unused = UINT32_MAX;
+    std::vector<uint32_t> remap(mesh.positions.size(), unused);
+    std::vector<glm::fvec3> positions;
+    positions.reserve(mesh.positions.size());
+    for (uint32_t & index : mesh.triangles) {
+        if (remap[index] == unused) {
+            remap[index] = positions.size();
+            positions.push_back(mesh.positions[index]);
+        }
+        index = remap[index];
+    }
+    mesh.positions.swap(positions);
+}
+
+/**
+ * @brief Renumbers the vertices with the reverse Cuthill-McKee ordering of the mesh graph, unless the current order
+ * already has a smaller bandwidth. Neighbouring vertices get nearby indices, so sweeps over constraints sorted by their
+ * first vertex touch memory almost sequentially, like the row-major sweep over a grid does
+ *
+ */
+inline void reorderCuthillMcKee(MeshData & mesh) {
+    uint32_t count = mesh.positions.size();
+
+    // Adjacency lists in compressed rows, every triangle connects each of its vertices to the other two
+    std::vector<uint32_t> rowStart(count + 1, 0);
+    for (uint32_t index : mesh.triangles) rowStart[index + 1] += 2;
+    for (uint32_t i = 0; i < count; ++i) rowStart[i + 1] += rowStart[i];
+    std::vector<uint32_t> neighbours(rowStart[count]);
+    std::vector<uint32_t> fill(rowStart.begin(), rowStart.end() - 1);
+    for (size_t t = 0; t < mesh.triangles.size(); t += 3) {
+        for (int k = 0; k < 3; ++k) {
+            uint32_t v = mesh.triangles[t + k];
+            neighbours[fill[v]++] = mesh.triangles[t + (k + 1) % 3];
+            neighbours[fill[v]++] = mesh.triangles[t + (k + 2) % 3];
+        }
+    }
+    // Interior edges are listed once per adjacent triangle, so duplicates are removed in place
+    std::vector<uint32_t> degree(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        auto begin = neighbours.begin() + rowStart[i];
+        auto end = neighbours.begin() + rowStart[i + 1];
+        std::sort(begin, end);
+        degree[i] = std::unique(begin, end) - begin;
+    }
+
+    const uint32_t unvisited = UINT32_MAX;
+    std::vector<uint32_t> level(count, unvisited);
+    std::vector<uint32_t> queue;
+    queue.reserve(count);
+    // Breadth first search from start over unordered vertices, returns a vertex of minimum degree in the last level
+    auto farthest = [&](uint32_t start) {
+        size_t first = queue.size();
+        queue.push_back(start);
+        level[start] = 0;
+        for (size_t head = first; head < queue.size(); ++head) {
+            uint32_t v = queue[head];
+            for (uint32_t k = rowStart[v]; k < rowStart[v] + degree[v]; ++k) {
+                uint32_t n = neighbours[k];
+                if (level[n] != unvisited) continue;
+                level[n] = level[v] + 1;
+                queue.push_back(n);
+            }
+        }
+        uint32_t best = queue.back();
+        for (size_t i = first; i < queue.size(); ++i) {
+            uint32_t v = queue[i];
+            if (level[v] == level[queue.back()] && degree[v] < degree[best]) best = v;
+        }
+        for (size_t i = first; i < queue.size(); ++i) level[queue[i]] = unvisited;
+        queue.resize(first);
+        return best;
+    };
+
+    std::vector<uint32_t> candidates;
+    for (uint32_t seed = 0; seed < count; ++seed) {
+        if (level[seed] != unvisited) continue;
+        // Starting from a pseudo-peripheral vertex keeps the levels of the search, and thus the bandwidth, narrow
+        uint32_t start = farthest(farthest(seed));
+        size_t head = queue.size();
+        queue.push_back(start);
+        level[start] = 0;
+        for (; head < queue.size(); ++head) {
+            uint32_t v = queue[head];
+            candidates.clear();
+            for (uint32_t k = rowStart[v]; k < rowStart[v] + degree[v]; ++k) {
+                uint32_t n = neighbours[k];
+                if (level[n] != unvisited) continue;
+                level[n] = 0;
+                candidates.push_back(n);
+            }
+            std::sort(candidates.begin(), candidates.end(), [&](uint32_t x, uint32_t y) {
+                return degree[x] < degree[y] || (degree[x] == degree[y] && x < y);
+            });
+            queue.insert(queue.end(), candidates.begin(), candidates.end());
+        }
+    }
+
+    std::vector<uint32_t> remap(count);
+    for (uint32_t i = 0; i < count; ++i) remap[queue[i]] = count - 1 - i;
+
+    // Cuthill-McKee aims for a small bandwidth, the largest index distance along an edge. The order the
+    // mesh came in can already be better, a grid in row-major order has half the bandwidth of its diagonal
+    // Cuthill-McKee levels and is swept faster
+    uint32_t currentBandwidth = 0;
+    uint32_t reorderedBandwidth = 0;
+    for (size_t t = 0; t < mesh.triangles.size(); t += 3) {
+        for (int k = 0; k < 3; ++k) {
+            uint32_t a = mesh.triangles[t + k];
+            uint32_t b = mesh.triangles[t + (k + 1) % 3];
+            currentBandwidth = std::max(currentBandwidth, a > b ? a - b : b - a);
+            reorderedBandwidth = std::max(reorderedBandwidth, remap[a] > remap[b] ? remap[a] - remap[b] : remap[b] - remap[a]);
+        }
+    }
+    if (reorderedBandwidth >= currentBandwidth) return;
+
+    std::vector<glm::fvec3> positions(count);
+    for (uint32_t i = 0; i < count; ++i) positions[remap[i]] = mesh.positions[i];
+    for (uint32_t & index : mesh.triangles) index = remap[index];
+    mesh.positions.swap(positions);
+}
+
+/**
+ * @brief Loads an OBJ or PLY mesh, chosen by the file extension, and reorders its vertices for locality
+ *
+ * @param path the mesh file
+ * @param mesh receives the mesh
+ * @return false if the file cannot be read or has no triangle with three distinct vertices
+ */
+inline bool loadMesh(const std::string & path, MeshData & mesh) {
+    std::shared_ptr<MappedFile> file = MappedFile::open(path);
+    if (!file) return false;
+
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+    bool loaded;
+    if (extension == "obj") loaded = loadOBJ(*file, mesh);
+    else if (extension == "ply") loaded = loadPLY(*file, mesh);
+    else {
+        std::cerr << "Unknown mesh format " << extension << ", expected obj or ply" << std::endl;
+        return false;
+    }
+    if (!loaded) {
+        std::cerr << "Could not load a triangle mesh from " << path << std::endl;
+        return false;
+    }
+
+    // Degenerate triangles would create constraints between a vertex and itself
+    size_t kept = 0;
+    for (size_t t = 0; t < mesh.triangles.size(); t += 3) {
+        uint32_t a = mesh.triangles[t], b = mesh.triangles[t + 1], c = mesh.triangles[t + 2];
+        if (a == b || b == c || a == c) continue;
+        mesh.triangles[kept++] = a;
+        mesh.triangles[kept++] = b;
+        mesh.triangles[kept++] = c;
+    }
+    mesh.triangles.resize(kept);
+    // Checked after the filter, since a mesh of only degenerate triangles leaves nothing to simulate
+    if (mesh.triangles.empty()) {
+        std::cerr << "Could not load a triangle mesh from " << path << std::endl;
+        return false;
+    }
+
+    reorderByFirstUse(mesh);
+    reorderCuthillMcKee(mesh);
+    return true;
+}
+
+/**
+ * @brief Finds the unique edges of the mesh and the bending pairs across edges shared by two triangles
+ *
+ */
+inline MeshTopology extractTopology(const MeshData & mesh) {
+    // Every triangle contributes its three edges as (smaller index, larger index, opposite vertex).
+    // Sorting brings the copies of an edge next to each other
+    struct HalfEdge {
+        uint64_t key;
+        uint32_t opposite;
+    };
+    std::vector<HalfEdge> halfEdges;
+    halfEdges.reserve(mesh.triangles.size());
+    for (size_t t = 0; t < mesh.triangles.size(); t += 3) {
+        for (int k = 0; k < 3; ++k) {
+            uint32_t a = mesh.triangles[t + k];
+            uint32_t b = mesh.triangles[t + (k + 1) % 3];
+            uint32_t opposite = mesh.triangles[t + (k + 2) % 3];
+            halfEdges.push_back(HalfEdge{ (uint64_t)std::min(a, b) << 32 | std::max(a, b), opposite });
+        }
+    }
+    std::sort(halfEdges.begin(), halfEdges.end(), [](const HalfEdge & x, const HalfEdge & y) {
+        return x.key < y.key || (x.key == y.key && x.opposite < y.opposite);
+    });
+
+    MeshTopology topology;
+    topology.edges.reserve(halfEdges.size() / 2 + 1);
+    for (size_t i = 0; i < halfEdges.size();) {
+        size_t j = i + 1;
+        while (j < halfEdges.size() && halfEdges[j].key == halfEdges[i].key) ++j;
+        topology.edges.push_back({ (uint32_t)(halfEdges[i].key >> 32), (uint32_t)halfEdges[i].key });
+        // Only manifold edges, shared by exactly two triangles, get a bending pair
+        if (j - i == 2 && halfEdges[i].opposite != halfEdges[i + 1].opposite) {
+            topology.bendingPairs.push_back({ halfEdges[i].opposite, halfEdges[i + 1].opposite });
+        }
+        i = j;
+    }
+
+    // Edges come out sorted by their smaller vertex, bending pairs are sorted the same way
+    for (auto & pair : topology.bendingPairs) {
+        if (pair.first > pair.second) std::swap(pair.first, pair.second);
+    }
+    std::sort(topology.bendingPairs.begin(), topology.bendingPairs.end());
+    return topology;
+}
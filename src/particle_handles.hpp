@@ -0,0 +1,118 @@
+/**
+ * @file particle_handles.hpp
+ * @brief Generational handles that keep referring to the same particle while the particle storage is reordered or compacted
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Refers to one particle until it is destroyed. A default constructed handle refers to nothing
+struct ParticleHandle {
+    uint32_t slot = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool operator==(const ParticleHandle & other) const {
+        return slot == other.slot && generation == other.generation;
+    }
+
+    bool operator!=(const ParticleHandle & other) const {
+        return !(*this == other);
+    }
+};
+
+/*
+Maps handles to the current index of their particle. Every handle names a slot and the generation
+the slot had when the handle was handed out. Destroying a particle frees its slot and bumps the
+generation, so old handles to it resolve to nothing instead of to whichever particle reuses the slot.
+Slots are only created for particles that a handle was asked for, so the table stays small.
+*/
+class ParticleHandles {
+    std::vector<uint32_t> indexOfSlot;
+    std::vector<uint32_t> generationOfSlot;
+    std::vector<uint32_t> slotOfIndex;
+    std::vector<uint32_t> freeSlots;
+
+    void freeSlot(uint32_t slot) {
+        indexOfSlot[slot] = UINT32_MAX;
+        ++generationOfSlot[slot];
+        freeSlots.push_back(slot);
+    }
+
+public:
+    /**
+     * @brief Returns the handle of a particle, the same one every time until the particle is destroyed
+     *
+     * @param index the current index of the particle
+     * @return the handle
+     */
+    ParticleHandle acquire(uint32_t index) {
+        if (index >= slotOfIndex.size()) slotOfIndex.resize(index + 1, UINT32_MAX);
+        uint32_t slot = slotOfIndex[index];
+        if (slot == UINT32_MAX) {
+            if (freeSlots.empty()) {
+                slot = indexOfSlot.size();
+                indexOfSlot.push_back(UINT32_MAX);
+                generationOfSlot.push_back(0);
+            }
+            else {
+                slot = freeSlots.back();
+                freeSlots.pop_back();
+            }
+            indexOfSlot[slot] = index;
+            slotOfIndex[index] = slot;
+        }
+        return ParticleHandle{ slot, generationOfSlot[slot] };
+    }
+
+    /**
+     * @brief Looks up the current index of a particle
+     *
+     * @param handle the handle of the particle
+     * @return the index, or UINT32_MAX if the particle was destroyed or the handle refers to nothing
+     */
+    uint32_t resolve(ParticleHandle handle) const {
+        if (handle.slot >= indexOfSlot.size() || generationOfSlot[handle.slot] != handle.generation) return UINT32_MAX;
+        return indexOfSlot[handle.slot];
+    }
+
+    // Invalidates the handles of a particle that was destroyed
+    void release(uint32_t index) {
+        if (index >= slotOfIndex.size() || slotOfIndex[index] == UINT32_MAX) return;
+        freeSlot(slotOfIndex[index]);
+        slotOfIndex[index] = UINT32_MAX;
+    }
+
+    /**
+     * @brief Follows the particles to their new indices after the storage was reordered or compacted
+     *
+     * @param remap the new index of every old index, UINT32_MAX for particles that were removed
+     * @param count the number of particles after the change
+     */
+    void remap(const std::vector<uint32_t> & remap, size_t count) {
+        std::vector<uint32_t> slots(count, UINT32_MAX);
+        for (size_t index = 0; index < slotOfIndex.size(); ++index) {
+            uint32_t slot = slotOfIndex[index];
+            if (slot == UINT32_MAX) continue;
+            uint32_t moved = index < remap.size() ? remap[index] : UINT32_MAX;
+            if (moved == UINT32_MAX) {
+                freeSlot(slot);
+                continue;
+            }
+            indexOfSlot[slot] = moved;
+            slots[moved] = slot;
+        }
+        slotOfIndex.swap(slots);
+    }
+
+    // Invalidates every handle, for when the particles are replaced by a different set
+    void clear() {
+        for (uint32_t slot = 0; slot < indexOfSlot.size(); ++slot) {
+            if (indexOfSlot[slot] != UINT32_MAX) freeSlot(slot);
+        }
+        slotOfIndex.clear();
+    }
+};
@@ -0,0 +1,160 @@
+/**
+ * @file perf_counters.hpp
+ * @brief Reads hardware performance counters of the calling thread through perf_event_open
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+The counters that are collected
+*/
+enum class Counter {
+    Cycles,
+    Instructions,
+    L1DataMisses,
+    LastLevelMisses,
+    BranchMisses,
+    PageFaults,
+    Count
+};
+
+inline const char * counterName(Counter counter) {
+    static const char * names[] = { "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses", "page_faults" };
+    return names[static_cast<int>(counter)];
+}
+
+/*
+Counter values of one measurement. A counter the kernel or the CPU does not provide, which is
+common in virtual machines, is marked as unavailable rather than reported as zero
+*/
+struct CounterValues {
+    uint64_t values[static_cast<int>(Counter::Count)] = {};
+    bool available[static_cast<int>(Counter::Count)] = {};
+
+    bool has(Counter counter) const {
+        return available[static_cast<int>(counter)];
+    }
+
+    uint64_t operator[](Counter counter) const {
+        return values[static_cast<int>(counter)];
+    }
+};
+
+/*
+One perf event per counter, counting user space work of the calling thread between start() and
+stop(). The counters are opened individually so that a missing one does not disable the others.
+When the CPU has fewer counter registers than events the kernel time-multiplexes them, and the
+values are scaled by the fraction of time each was actually counting.
+*/
+class PerfCounters {
+    int fds[static_cast<int>(Counter::Count)];
+
+public:
+    PerfCounters() {
+        for (int & fd : fds) fd = -1;
+#if defined(__linux__)
+        for (int i = 0; i < static_cast<int>(Counter::Count); ++i) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            configure(static_cast<Counter>(i), attr);
+            fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters & operator=(const PerfCounters &) = delete;
+
+    ~PerfCounters() {
+#if defined(__linux__)
+        for (int fd : fds) {
+            if (fd >= 0) close(fd);
+        }
+#endif
+    }
+
+    // Whether any hardware counter could be opened
+    bool hasHardwareCounters() const {
+        for (int i = 0; i < static_cast<int>(Counter::PageFaults); ++i) {
+            if (fds[i] >= 0) return true;
+        }
+        return false;
+    }
+
+    void start() {
+#if defined(__linux__)
+        for (int fd : fds) {
+            if (fd < 0) continue;
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    CounterValues stop() {
+        CounterValues result;
+#if defined(__linux__)
+        for (int fd : fds) {
+            if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+        for (int i = 0; i < static_cast<int>(Counter::Count); ++i) {
+            uint64_t data[3];
+            if (fds[i] < 0 || read(fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) continue;
+            result.values[i] = data[2] == data[1] ? data[0] : static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+            result.available[i] = true;
+        }
+#endif
+        return result;
+    }
+
+private:
+#if defined(__linux__)
+    static void configure(Counter counter, perf_event_attr & attr) {
+        auto cacheMiss = [](uint64_t cache) {
+            return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        };
+        attr.type = PERF_TYPE_HARDWARE;
+        switch (counter) {
+        case Counter::Cycles:
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case Counter::Instructions:
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case Counter::L1DataMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cacheMiss(PERF_COUNT_HW_CACHE_L1D);
+            break;
+        case Counter::LastLevelMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cacheMiss(PERF_COUNT_HW_CACHE_LL);
+            break;
+        case Counter::BranchMisses:
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case Counter::PageFaults:
+            attr.type = PERF_TYPE_SOFTWARE;
+            attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+            break;
+        case Counter::Count:
+            break;
+        }
+    }
+#endif
+};
@@ -0,0 +1,228 @@
+/**
+ * @file profiler.hpp
+ * @brief Scoped timers that collect per-phase duration histograms
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "trace.hpp"
+
+/*
+The parts of a frame that are timed separately
+*/
+enum class Phase {
+    Frame,
+    Input,
+    Update,
+    Integrate,
+    ConstraintIteration,
+    Tearing,
+    Collision,
+    Draw,
+    Readback,
+    SwapBuffers,
+    PollEvents,
+    Count
+};
+
+inline const char * phaseName(Phase phase) {
+    static const char * names[] = { "frame", "input", "update", "integrate", "constraint_iteration", "tearing", "collision", "draw",
+                                    "readback", "swap_buffers", "poll_events" };
+    return names[static_cast<int>(phase)];
+}
+
+/*
+A histogram of durations in nanoseconds with log-linear buckets in the style of HdrHistogram.
+Every power of two is split into 2^subBucketBits equal buckets, so any recorded value is known to
+within about 3 percent while the whole range up to minutes fits in about a thousand counters.
+Recording is a few shifts and an increment.
+*/
+class DurationHistogram {
+    static const int subBucketBits = 5;
+    static const uint64_t subBuckets = 1ull << subBucketBits;
+    static const int octaves = 40 - subBucketBits;
+
+    std::vector<uint64_t> counts = std::vector<uint64_t>((octaves + 1) * subBuckets, 0);
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t largest = 0;
+
+public:
+    void record(uint64_t nanoseconds) {
+        ++counts[bucketOf(nanoseconds)];
+        ++total;
+        sum += nanoseconds;
+        largest = std::max(largest, nanoseconds);
+    }
+
+    uint64_t count() const {
+        return total;
+    }
+
+    uint64_t max() const {
+        return largest;
+    }
+
+    double mean() const {
+        return total ? static_cast<double>(sum) / total : 0.0;
+    }
+
+    /**
+     * @brief Returns a duration that at least the given fraction of the recorded durations do not exceed
+     *
+     * @param fraction between 0 and 1, for example 0.99 for the 99th percentile
+     * @return the upper end of the bucket the percentile falls into, in nanoseconds
+     */
+    uint64_t percentile(double fraction) const {
+        if (total == 0) return 0;
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * total + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            seen += counts[i];
+            if (seen >= rank) return std::min(largest, upperBound(i));
+        }
+        return largest;
+    }
+
+    void reset() {
+        std::fill(counts.begin(), counts.end(), 0);
+        total = sum = largest = 0;
+    }
+
+private:
+    static size_t bucketOf(uint64_t value) {
+        if (value < subBuckets) return value;
+        int msb = 63 - __builtin_clzll(value);
+        int shift = std::min(msb - subBucketBits, octaves - 1);
+        uint64_t sub = std::min<uint64_t>((value >> shift) - subBuckets, subBuckets - 1);
+        return (shift + 1) * subBuckets + sub;
+    }
+
+    static uint64_t upperBound(size_t bucket) {
+        if (bucket < subBuckets) return bucket;
+        int shift = bucket / subBuckets - 1;
+        uint64_t sub = bucket % subBuckets + subBuckets;
+        return ((sub + 1) << shift) - 1;
+    }
+};
+
+/*
+Summary statistics of one phase in microseconds
+*/
+struct PhaseSummary {
+    uint64_t count;
+    double mean;
+    double p50;
+    double p99;
+    double max;
+};
+
+/*
+Collects the durations of every phase. Timers are only recorded from the simulation thread and
+cost one branch while the profiler is disabled.
+*/
+class Profiler {
+    DurationHistogram histograms[static_cast<int>(Phase::Count)];
+    bool enabled = false;
+
+public:
+    // The profiler the scoped timers record into
+    static Profiler & instance() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    bool isEnabled() const {
+        return enabled;
+    }
+
+    void setEnabled(bool enable) {
+        enabled = enable;
+    }
+
+    void record(Phase phase, uint64_t nanoseconds) {
+        histograms[static_cast<int>(phase)].record(nanoseconds);
+    }
+
+    const DurationHistogram & histogram(Phase phase) const {
+        return histograms[static_cast<int>(phase)];
+    }
+
+    PhaseSummary summary(Phase phase) const {
+        const DurationHistogram & h = histogram(phase);
+        return PhaseSummary{ h.count(), h.mean() / 1000.0, h.percentile(0.5) / 1000.0, h.percentile(0.99) / 1000.0, h.max() / 1000.0 };
+    }
+
+    void reset() {
+        for (DurationHistogram & h : histograms) h.reset();
+    }
+
+    /**
+     * @brief Writes the summary of every phase to a file, as JSON if the path ends in .json and as CSV otherwise.
+     * The file is replaced, so calling this periodically keeps it up to date with everything recorded so far
+     *
+     * @return false if the file cannot be written
+     */
+    bool dump(const std::string & path) const {
+        bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+        std::string temporary = path + ".tmp";
+        std::FILE * file = std::fopen(temporary.c_str(), "w");
+        if (!file) {
+            std::cerr << "Could not write profile " << path << std::endl;
+            return false;
+        }
+        if (json) std::fprintf(file, "{\n");
+        else std::fprintf(file, "phase,count,mean_us,p50_us,p99_us,max_us\n");
+        for (int i = 0; i < static_cast<int>(Phase::Count); ++i) {
+            Phase phase = static_cast<Phase>(i);
+            PhaseSummary s = summary(phase);
+            if (json) {
+                std::fprintf(file, "  \"%s\": {\"count\": %llu, \"mean_us\": %.3f, \"p50_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f}%s\n",
+                             phaseName(phase), static_cast<unsigned long long>(s.count), s.mean, s.p50, s.p99, s.max,
+                             i + 1 < static_cast<int>(Phase::Count) ? "," : "");
+            }
+            else {
+                std::fprintf(file, "%s,%llu,%.3f,%.3f,%.3f,%.3f\n", phaseName(phase), static_cast<unsigned long long>(s.count),
+                             s.mean, s.p50, s.p99, s.max);
+            }
+        }
+        if (json) std::fprintf(file, "}\n");
+        bool written = std::fclose(file) == 0;
+        return written && std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+};
+
+/*
+Records the time from its construction to its destruction as one sample of a phase, and as an event
+on the timeline of the calling thread while a trace is being written
+*/
+class ScopedTimer {
+    Phase phase;
+    bool profiled;
+    bool traced;
+    uint64_t start = 0;
+
+public:
+    explicit ScopedTimer(Phase phase)
+        : phase(phase), profiled(Profiler::instance().isEnabled()), traced(Tracer::instance().isEnabled()) {
+        if (profiled || traced) start = Tracer::instance().now();
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer & operator=(const ScopedTimer &) = delete;
+
+    ~ScopedTimer() {
+        if (!profiled && !traced) return;
+        uint64_t end = Tracer::instance().now();
+        if (profiled) Profiler::instance().record(phase, end - start);
+        if (traced) Tracer::instance().record(phaseName(phase), start, end);
+    }
+};
@@ -0,0 +1,401 @@
+/**
+ * @file recorder.hpp
+ * @brief Records simulated frames to a compressed stream and reads them back for offline review
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm.hpp>
+#include "bounded_queue.hpp"
+#include "rans.hpp"
+#include "trace.hpp"
+
+/*
+The positions and destroyed flags of every vertex after one simulation step, and the vertices that every
+compaction of the cloth since the previous recorded frame removed, by their index before that compaction
+*/
+struct RecordedFrame {
+    uint32_t index = 0;
+    std::vector<glm::fvec3> positions;
+    std::vector<uint8_t> destroyed;
+    std::vector<std::vector<uint32_t>> compactions;
+};
+
+/*
+Recording file layout, all values little-endian:
+
+    "CLOTHREC", uint32 version, float precision
+    per frame: uint32 record size, uint32 frame index, uint32 vertex count, uint8 flags,
+               int32 origin[3], uint32 stream size, rANS block
+
+Flag bit 0 marks a keyframe and bit 1 a frame that follows compactions of the cloth. Such a frame is
+always a keyframe, and its stream starts with the number of compactions and, for each, the number of
+removed vertices and their indices as gaps between consecutive indices.
+
+Positions are quantized to a grid with a spacing of precision units. A keyframe stores every
+coordinate relative to the minimum corner (origin) of the frame's bounding box, other frames store
+the difference to the previous frame on the same grid, so the error never exceeds precision / 2
+and does not accumulate. From the second frame after a keyframe on, the difference is taken to the
+previous frame moved on by its own velocity (2 * previous - the frame before), which for a swinging
+cloth roughly halves the stream. The values are written as zigzag varints, followed by the indices
+of vertices whose destroyed flag changed, and the resulting bytes are entropy coded with rANS.
+*/
+const uint32_t recordingVersion = 2;
+const uint8_t recordingKeyframe = 1;
+const uint8_t recordingCompacted = 2;
+
+namespace recording {
+
+inline void putVarint(std::vector<uint8_t> & out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+inline bool getVarint(const std::vector<uint8_t> & in, std::size_t & pos, uint32_t & value) {
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (pos >= in.size()) return false;
+        uint8_t byte = in[pos++];
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+inline uint32_t zigzag(int32_t value) {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+inline int32_t unzigzag(uint32_t value) {
+    return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+// Predicts a quantized coordinate from the two frames before it, if the older one is known
+inline int32_t predict(const std::vector<int32_t> & previous, const std::vector<int32_t> & beforePrevious, std::size_t i) {
+    if (beforePrevious.size() != previous.size()) return previous[i];
+    return static_cast<int32_t>(2 * static_cast<int64_t>(previous[i]) - beforePrevious[i]);
+}
+
+template <typename T>
+void putRaw(std::vector<uint8_t> & out, T value) {
+    const uint8_t * bytes = reinterpret_cast<const uint8_t *>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+T getRaw(const uint8_t * data) {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+}
+
+/*
+Records frames to a file. The simulation thread only copies the vertex state into a pooled frame
+and offers it to a bounded queue without waiting; quantization, entropy coding and disk I/O happen
+on a writer thread. When the writer falls behind, frames are dropped and counted instead of
+stalling the simulation, and the frame indices in the file show the gap.
+*/
+class FrameRecorder {
+    std::ofstream file;
+    float precision;
+    int keyframeInterval;
+    BoundedQueue<RecordedFrame> queue;
+    std::mutex poolMutex;
+    std::vector<RecordedFrame> pool;
+    std::thread worker;
+    std::atomic<int> dropped{ 0 };
+
+    // Encoder state, only used by the writer thread
+    std::vector<int32_t> previous;
+    std::vector<int32_t> beforePrevious;
+    std::vector<uint8_t> previousDestroyed;
+    int framesSinceKeyframe = 0;
+    uint64_t inputBytes = 0;
+    uint64_t outputBytes = 0;
+
+public:
+    /**
+     * @brief Opens the recording and starts the writer thread
+     *
+     * @param path the file to record to
+     * @param precision the quantization step in world units
+     * @param queueDepth how many frames may wait for the writer before new frames are dropped
+     * @param keyframeInterval the number of frames between keyframes
+     */
+    FrameRecorder(const std::string & path, float precision = 0.01f, std::size_t queueDepth = 4, int keyframeInterval = 120)
+        : file(path, std::ios::binary | std::ios::trunc), precision(precision), keyframeInterval(keyframeInterval), queue(queueDepth) {
+        if (!file) {
+            std::cerr << "Could not open recording " << path << std::endl;
+            return;
+        }
+        std::vector<uint8_t> header;
+        header.insert(header.end(), { 'C', 'L', 'O', 'T', 'H', 'R', 'E', 'C' });
+        recording::putRaw<uint32_t>(header, recordingVersion);
+        recording::putRaw<float>(header, precision);
+        file.write(reinterpret_cast<const char *>(header.data()), header.size());
+        worker = std::thread([this] { run(); });
+    }
+
+    ~FrameRecorder() {
+        finish();
+    }
+
+    bool isOpen() const {
+        return worker.joinable();
+    }
+
+    // Returns an empty frame, reusing the buffers of frames that have already been written
+    RecordedFrame acquire() {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (pool.empty()) return RecordedFrame();
+        RecordedFrame frame = std::move(pool.back());
+        pool.pop_back();
+        return frame;
+    }
+
+    /**
+     * @brief Hands a frame to the writer thread. Never waits, the frame is dropped if the queue is full
+     *
+     * @param frame the frame to record
+     * @return false if the frame was dropped
+     */
+    bool submit(RecordedFrame frame) {
+        if (queue.tryPush(frame)) return true;
+        ++dropped;
+        release(std::move(frame));
+        return false;
+    }
+
+    // Writes the queued frames, stops the writer thread and reports how well the stream compressed
+    void finish() {
+        queue.close();
+        if (!worker.joinable()) return;
+        worker.join();
+        file.flush();
+        if (inputBytes > 0) {
+            std::cerr << "Recorded " << outputBytes << " bytes for " << inputBytes << " bytes of positions ("
+                      << (double)inputBytes / std::max<uint64_t>(outputBytes, 1) << "x)";
+            if (dropped > 0) std::cerr << ", " << dropped << " frames were dropped";
+            std::cerr << std::endl;
+        }
+    }
+
+    int droppedFrames() const {
+        return dropped;
+    }
+
+private:
+    void release(RecordedFrame frame) {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        pool.push_back(std::move(frame));
+    }
+
+    void run() {
+        RecordedFrame frame;
+        std::vector<uint8_t> stream;
+        std::vector<uint8_t> record;
+        Tracer::instance().nameThread("recorder");
+        while (queue.pop(frame)) {
+            TraceScope scope("encode_frame");
+            encode(frame, stream, record);
+            file.write(reinterpret_cast<const char *>(record.data()), record.size());
+            inputBytes += frame.positions.size() * sizeof(glm::fvec3);
+            outputBytes += record.size();
+            release(std::move(frame));
+        }
+    }
+
+    void encode(const RecordedFrame & frame, std::vector<uint8_t> & stream, std::vector<uint8_t> & record) {
+        std::size_t count = frame.positions.size();
+        // After a compaction the previous frames are indexed differently
+        bool compacted = !frame.compactions.empty();
+        bool keyframe = compacted || previous.size() != count * 3 || framesSinceKeyframe >= keyframeInterval;
+        framesSinceKeyframe = keyframe ? 1 : framesSinceKeyframe + 1;
+
+        std::vector<int32_t> current(count * 3);
+        int32_t origin[3] = { INT32_MAX, INT32_MAX, INT32_MAX };
+        for (std::size_t i = 0; i < count; ++i) {
+            for (int axis = 0; axis < 3; ++axis) {
+                float value = frame.positions[i][axis] / precision;
+                int32_t q = std::isfinite(value) ? static_cast<int32_t>(std::lround(std::max(-1.0e9f, std::min(1.0e9f, value)))) : 0;
+                current[i * 3 + axis] = q;
+                origin[axis] = std::min(origin[axis], q);
+            }
+        }
+        if (count == 0) origin[0] = origin[1] = origin[2] = 0;
+
+        stream.clear();
+        if (compacted) {
+            recording::putVarint(stream, frame.compactions.size());
+            for (const std::vector<uint32_t> & removed : frame.compactions) {
+                recording::putVarint(stream, removed.size());
+                uint32_t last = 0;
+                for (uint32_t index : removed) {
+                    recording::putVarint(stream, index - last);
+                    last = index;
+                }
+            }
+        }
+        if (keyframe) {
+            for (std::size_t i = 0; i < current.size(); ++i) {
+                recording::putVarint(stream, static_cast<uint32_t>(current[i] - origin[i % 3]));
+            }
+            previousDestroyed.assign(count, 0);
+        }
+        else {
+            for (std::size_t i = 0; i < current.size(); ++i) {
+                recording::putVarint(stream, recording::zigzag(current[i] - recording::predict(previous, beforePrevious, i)));
+            }
+        }
+
+        // Indices of vertices whose destroyed flag changed, as gaps between consecutive indices
+        std::vector<uint32_t> toggled;
+        for (std::size_t i = 0; i < count && i < frame.destroyed.size(); ++i) {
+            if ((frame.destroyed[i] != 0) != (previousDestroyed[i] != 0)) toggled.push_back(i);
+        }
+        recording::putVarint(stream, toggled.size());
+        uint32_t last = 0;
+        for (uint32_t index : toggled) {
+            recording::putVarint(stream, index - last);
+            last = index;
+            previousDestroyed[index] ^= 1;
+        }
+        if (keyframe) beforePrevious.clear();
+        else beforePrevious.swap(previous);
+        previous = std::move(current);
+
+        record.clear();
+        recording::putRaw<uint32_t>(record, 0);
+        recording::putRaw<uint32_t>(record, frame.index);
+        recording::putRaw<uint32_t>(record, count);
+        record.push_back((keyframe ? recordingKeyframe : 0) | (compacted ? recordingCompacted : 0));
+        for (int axis = 0; axis < 3; ++axis) recording::putRaw<int32_t>(record, keyframe ? origin[axis] : 0);
+        recording::putRaw<uint32_t>(record, stream.size());
+        rans::encode(stream, record);
+        uint32_t size = record.size() - sizeof(uint32_t);
+        std::memcpy(record.data(), &size, sizeof(size));
+    }
+};
+
+/*
+Reads a recording written by FrameRecorder one frame at a time
+*/
+class RecordingReader {
+    std::ifstream file;
+    float precision = 0;
+    std::vector<int32_t> previous;
+    std::vector<int32_t> beforePrevious;
+    std::vector<int32_t> current;
+    std::vector<uint8_t> destroyed;
+
+public:
+    /**
+     * @brief Opens a recording and checks its header
+     *
+     * @return false if the file is not a recording this build can read
+     */
+    bool open(const std::string & path) {
+        file.open(path, std::ios::binary);
+        char header[16];
+        if (!file.read(header, sizeof(header)) || std::memcmp(header, "CLOTHREC", 8) != 0 ||
+            recording::getRaw<uint32_t>(reinterpret_cast<uint8_t *>(header + 8)) != recordingVersion) {
+            std::cerr << "Could not read recording " << path << std::endl;
+            return false;
+        }
+        precision = recording::getRaw<float>(reinterpret_cast<uint8_t *>(header + 12));
+        return true;
+    }
+
+    /**
+     * @brief Decodes the next frame
+     *
+     * @param frame receives the frame
+     * @return false at the end of the recording or if the frame is corrupt
+     */
+    bool next(RecordedFrame & frame) {
+        uint32_t size;
+        if (!file.read(reinterpret_cast<char *>(&size), sizeof(size))) return false;
+        const std::size_t fixedSize = 4 + 4 + 1 + 12 + 4;
+        std::vector<uint8_t> record(size);
+        if (size < fixedSize || !file.read(reinterpret_cast<char *>(record.data()), size)) {
+            std::cerr << "Recording ends with a truncated frame" << std::endl;
+            return false;
+        }
+
+        frame.index = recording::getRaw<uint32_t>(&record[0]);
+        uint32_t count = recording::getRaw<uint32_t>(&record[4]);
+        bool keyframe = record[8] & recordingKeyframe;
+        bool compacted = record[8] & recordingCompacted;
+        int32_t origin[3];
+        for (int axis = 0; axis < 3; ++axis) origin[axis] = recording::getRaw<int32_t>(&record[9 + axis * 4]);
+        uint32_t streamSize = recording::getRaw<uint32_t>(&record[21]);
+
+        std::vector<uint8_t> stream;
+        if (!rans::decode(record.data() + fixedSize, record.size() - fixedSize, streamSize, stream) ||
+            (!keyframe && previous.size() != (std::size_t)count * 3)) {
+            std::cerr << "Recording frame " << frame.index << " is corrupt" << std::endl;
+            return false;
+        }
+
+        std::size_t pos = 0;
+        frame.compactions.clear();
+        uint32_t compactions = 0;
+        if (compacted && !recording::getVarint(stream, pos, compactions)) return false;
+        for (uint32_t c = 0; c < compactions; ++c) {
+            uint32_t removedCount;
+            if (!recording::getVarint(stream, pos, removedCount) || removedCount > stream.size() - pos) return false;
+            frame.compactions.emplace_back(removedCount);
+            uint32_t index = 0;
+            for (uint32_t & removed : frame.compactions.back()) {
+                uint32_t gap;
+                if (!recording::getVarint(stream, pos, gap)) return false;
+                index += gap;
+                removed = index;
+            }
+        }
+        current.resize((std::size_t)count * 3);
+        if (keyframe) destroyed.assign(count, 0);
+        for (std::size_t i = 0; i < current.size(); ++i) {
+            uint32_t value;
+            if (!recording::getVarint(stream, pos, value)) return false;
+            if (keyframe) current[i] = origin[i % 3] + static_cast<int32_t>(value);
+            else current[i] = recording::predict(previous, beforePrevious, i) + recording::unzigzag(value);
+        }
+        if (keyframe) beforePrevious.clear();
+        else beforePrevious.swap(previous);
+        previous.swap(current);
+        uint32_t toggledCount;
+        if (!recording::getVarint(stream, pos, toggledCount)) return false;
+        uint32_t index = 0;
+        for (uint32_t i = 0; i < toggledCount; ++i) {
+            uint32_t gap;
+            if (!recording::getVarint(stream, pos, gap) || index + gap >= count) return false;
+            index += gap;
+            destroyed[index] ^= 1;
+        }
+
+        frame.positions.resize(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            frame.positions[i] = glm::fvec3(previous[i * 3], previous[i * 3 + 1], previous[i * 3 + 2]) * precision;
+        }
+        frame.destroyed = destroyed;
+        return true;
+    }
+};
@@ -0,0 +1,267 @@
+/**
+ * @file snapshot.hpp
+ * @brief Versioned binary snapshot format that can be memory mapped and used in place
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "mapped_file.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+A snapshot file starts with a fixed size SnapshotHeader followed by raw arrays, each starting at
+a multiple of snapshotAlignment bytes. The arrays are stored exactly as they are laid out in
+memory, so a mapped snapshot can be used as the particle store directly. Files are only valid on
+machines with the same endianness and struct layout, which the element sizes in the header guard.
+*/
+const uint32_t snapshotVersion = 5;
+const uint64_t snapshotAlignment = 64;
+const uint32_t snapshotMaxSections = 16;
+
+enum SnapshotSection : uint32_t {
+    SectionVertices = 0,
+    SectionConstraints = 1,
+    // Optional, only cloths built from a mesh have bending constraints
+    SectionBendingConstraints = 2,
+    // Optional, only checkpoints store the state needed to continue a simulation exactly
+    SectionRuntimeState = 3,
+    // Optional, one byte per vertex in checkpoints: whether its fragment sleeps (bit 7) and for how
+    // many checks the fragment has been quiet (bits 0 to 6)
+    SectionFragmentState = 4,
+    // Optional, the attachments of a checkpoint as SnapshotAttachment
+    SectionAttachments = 5,
+    // The index of the first constraint of every colour followed by the number of constraints, see colourConstraints().
+    // Tearing leaves the constraints in an order that colouring them again would not reproduce, so the ranges are stored
+    SectionConstraintColours = 6,
+    // Optional, the colour ranges of the bending constraints
+    SectionBendingColours = 7,
+    // The constraints at every vertex as the cloth indexes them, see Cloth::adjacency. Stored so that loading
+    // maps the index instead of rebuilding it from the constraints
+    SectionAdjacency = 8,
+    SectionAdjacencyStart = 9,
+    SectionAdjacencyCount = 10,
+    // The fragment of every vertex, numbered from 0 in the order of the fragments, UINT32_MAX for destroyed vertices
+    SectionFragments = 11,
+    // Optional, the vertex at every position of a compacted grid, UINT32_MAX where compaction removed it
+    SectionGridVertices = 12
+};
+
+struct SnapshotSectionEntry {
+    uint64_t offset;
+    uint64_t count;
+    uint32_t elementSize;
+    uint32_t present;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    int32_t rows;
+    int32_t cols;
+    float segmentLength;
+    float drag;
+    int32_t iterations;
+    float breakingLimit;
+    float bendingStiffness;
+    uint32_t reserved;
+    SnapshotSectionEntry sections[snapshotMaxSections];
+};
+
+/*
+Everything besides the vertices and constraints that the next simulated step depends on, and how far
+the driver of the simulation had come when the checkpoint was taken
+*/
+struct SnapshotRuntimeState {
+    uint32_t step;
+    int32_t grabbedIndex;
+    double simulationTime;
+    double timeSinceLastMouse;
+    float mousePosition[3];
+    uint32_t quietSteps;
+    uint8_t rightMousePressed;
+    uint8_t asleep;
+    uint8_t reserved[6];
+    uint64_t frame;
+    uint64_t inputEvent;
+};
+
+// A particle that is pulled towards a target, see Cloth::attach()
+struct SnapshotAttachment {
+    uint32_t vertex;
+    float target[3];
+    float stiffness;
+};
+
+/*
+Collects the header and the arrays of a snapshot and writes them to disk
+*/
+class SnapshotWriter {
+    struct Pending {
+        const void * data;
+        uint64_t bytes;
+    };
+
+    SnapshotHeader header;
+    std::vector<Pending> pending;
+
+public:
+    SnapshotWriter() {
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "CLOTHSNP", 8);
+        header.version = snapshotVersion;
+        header.headerSize = sizeof(SnapshotHeader);
+        pending.resize(snapshotMaxSections, Pending{ nullptr, 0 });
+    }
+
+    SnapshotHeader & getHeader() {
+        return header;
+    }
+
+    /**
+     * @brief Adds an array to the snapshot. The data must stay alive until write() is called
+     *
+     * @param section which section the array is stored as
+     * @param data the first element
+     * @param count the number of elements
+     * @param elementSize the size of one element in bytes
+     */
+    void addSection(SnapshotSection section, const void * data, uint64_t count, uint32_t elementSize) {
+        header.sections[section].count = count;
+        header.sections[section].elementSize = elementSize;
+        header.sections[section].present = 1;
+        pending[section] = Pending{ data, count * elementSize };
+    }
+
+    /**
+     * @brief Writes the snapshot to a temporary file next to the target, flushes it to disk and renames it into place.
+     * A snapshot that is currently mapped is therefore never overwritten while in use, and after a crash the
+     * target holds either the previous or the new snapshot in full
+     *
+     * @param path where to write the snapshot
+     * @return false if the file could not be written
+     */
+    bool write(const std::string & path) {
+        uint64_t offset = align(sizeof(SnapshotHeader));
+        for (uint32_t i = 0; i < snapshotMaxSections; ++i) {
+            if (!header.sections[i].present) continue;
+            header.sections[i].offset = offset;
+            offset = align(offset + pending[i].bytes);
+        }
+
+        std::string temporary = path + ".tmp";
+        std::FILE * file = std::fopen(temporary.c_str(), "wb");
+        if (!file) {
+            std::cerr << "Failed to create snapshot " << temporary << std::endl;
+            return false;
+        }
+        bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+        uint64_t position = sizeof(header);
+        for (uint32_t i = 0; i < snapshotMaxSections && written; ++i) {
+            if (!header.sections[i].present) continue;
+            written = pad(file, header.sections[i].offset - position) &&
+                      std::fwrite(pending[i].data, 1, pending[i].bytes, file) == pending[i].bytes;
+            position = header.sections[i].offset + pending[i].bytes;
+        }
+        written = written && std::fflush(file) == 0 && syncFile(file);
+        if (std::fclose(file) != 0 || !written) {
+            std::cerr << "Failed to write snapshot " << temporary << std::endl;
+            std::remove(temporary.c_str());
+            return false;
+        }
+        if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::cerr << "Failed to move snapshot into place at " << path << std::endl;
+            return false;
+        }
+        syncDirectory(path);
+        return true;
+    }
+
+private:
+    static uint64_t align(uint64_t offset) {
+        return (offset + snapshotAlignment - 1) / snapshotAlignment * snapshotAlignment;
+    }
+
+    static bool pad(std::FILE * file, uint64_t bytes) {
+        static const char zeros[snapshotAlignment] = {};
+        while (bytes > 0) {
+            uint64_t chunk = bytes < snapshotAlignment ? bytes : snapshotAlignment;
+            if (std::fwrite(zeros, 1, chunk, file) != chunk) return false;
+            bytes -= chunk;
+        }
+        return true;
+    }
+
+    // Waits until the contents of the file have reached the disk
+    static bool syncFile(std::FILE * file) {
+#if defined(__unix__) || defined(__APPLE__)
+        return fsync(fileno(file)) == 0;
+#else
+        return true;
+#endif
+    }
+
+    // Waits until the directory entry of a renamed file has reached the disk
+    static void syncDirectory(const std::string & path) {
+#if defined(__unix__) || defined(__APPLE__)
+        std::string::size_type slash = path.find_last_of('/');
+        std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+        int fd = ::open(directory.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        fsync(fd);
+        ::close(fd);
+#endif
+    }
+};
+
+/**
+ * @brief Checks that a mapped file is a snapshot this build can use in place
+ *
+ * @param file the mapped file
+ * @return the header inside the mapping, or nullptr if the file is not a compatible snapshot
+ */
+inline const SnapshotHeader * readSnapshotHeader(const MappedFile & file) {
+    if (file.size() < sizeof(SnapshotHeader)) {
+        std::cerr << "Snapshot is too small to contain a header" << std::endl;
+        return nullptr;
+    }
+    const SnapshotHeader * header = reinterpret_cast<const SnapshotHeader *>(file.data());
+    if (std::memcmp(header->magic, "CLOTHSNP", 8) != 0) {
+        std::cerr << "File is not a cloth snapshot" << std::endl;
+        return nullptr;
+    }
+    if (header->version != snapshotVersion || header->headerSize != sizeof(SnapshotHeader)) {
+        std::cerr << "Unsupported snapshot version " << header->version << std::endl;
+        return nullptr;
+    }
+    return header;
+}
+
+/**
+ * @brief Checks that a section is present, holds elements of the expected size and lies within the file
+ *
+ * @return false if the section cannot be used
+ */
+inline bool checkSnapshotSection(const MappedFile & file, const SnapshotHeader & header, SnapshotSection section, uint32_t elementSize) {
+    const SnapshotSectionEntry & entry = header.sections[section];
+    if (!entry.present || entry.elementSize != elementSize || entry.offset % snapshotAlignment != 0) {
+        std::cerr << "Snapshot section " << section << " is missing or has an incompatible layout" << std::endl;
+        return false;
+    }
+    if (entry.offset > file.size() || entry.count > (file.size() - entry.offset) / elementSize) {
+        std::cerr << "Snapshot section " << section << " is truncated" << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file spatial_hash.hpp
+ * @brief A uniform grid over the x-y plane, hashed into a table the size of the point count, for finding points near a position
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+Sorts points into the cells of a uniform grid in the x-y plane. Cells are hashed into a power of two
+sized table, so far apart cells may share a bucket and a query returns candidates that the caller
+still has to test. Building counts the points per bucket and places them in index order, so the
+candidates of a bucket come in index order too.
+*/
+class SpatialHash {
+    float cellSize = 1.0f;
+    uint32_t mask = 0;
+    std::vector<uint32_t> bucketStart;
+    std::vector<uint32_t> entries;
+    std::vector<uint32_t> bucketOfEntry;
+
+    uint32_t bucket(int64_t x, int64_t y) const {
+        return ((uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u) & mask;
+    }
+
+    int64_t cell(float coordinate) const {
+        return (int64_t)std::floor(coordinate / cellSize);
+    }
+
+public:
+    /**
+     * @brief Replaces the contents with a set of points
+     *
+     * @param count the number of points, which are referred to by their index
+     * @param size the edge length of a cell, best about the radius of the typical query
+     * @param position called as position(i, x, y), sets the coordinates of point i and returns false to leave it out
+     */
+    template <typename F>
+    void build(size_t count, float size, F && position) {
+        cellSize = size;
+        uint32_t buckets = 1;
+        while (buckets < count) buckets *= 2;
+        mask = buckets - 1;
+
+        bucketOfEntry.assign(count, UINT32_MAX);
+        bucketStart.assign(buckets + 1, 0);
+        for (size_t i = 0; i < count; ++i) {
+            float x, y;
+            if (!position(i, x, y)) continue;
+            bucketOfEntry[i] = bucket(cell(x), cell(y));
+            ++bucketStart[bucketOfEntry[i] + 1];
+        }
+        for (uint32_t b = 0; b < buckets; ++b) bucketStart[b + 1] += bucketStart[b];
+
+        entries.resize(bucketStart[buckets]);
+        std::vector<uint32_t> next(bucketStart.begin(), bucketStart.end() - 1);
+        for (size_t i = 0; i < count; ++i) {
+            if (bucketOfEntry[i] != UINT32_MAX) entries[next[bucketOfEntry[i]]++] = i;
+        }
+    }
+
+    /**
+     * @brief Calls visit(i) once for every point in a bucket of a cell that overlaps the square around a position
+     *
+     * @param x the x-coordinate of the position
+     * @param y the y-coordinate of the position
+     * @param radius half the edge length of the square
+     * @param visit called with the index of every candidate
+     */
+    template <typename F>
+    void query(float x, float y, float radius, F && visit) const {
+        if (entries.empty()) return;
+        // Neighbouring cells can hash to the same bucket, which must not be visited twice
+        std::vector<uint32_t> visited;
+        for (int64_t cx = cell(x - radius); cx <= cell(x + radius); ++cx) {
+            for (int64_t cy = cell(y - radius); cy <= cell(y + radius); ++cy) {
+                uint32_t b = bucket(cx, cy);
+                if (std::find(visited.begin(), visited.end(), b) != visited.end()) continue;
+                visited.push_back(b);
+                for (uint32_t e = bucketStart[b]; e < bucketStart[b + 1]; ++e) visit(entries[e]);
+            }
+        }
+    }
+};
@@ -0,0 +1,129 @@
+/**
+ * @file thread_pool.hpp
+ * @brief A fixed set of worker threads that run the chunks of parallel loops
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "trace.hpp"
+
+/*
+Runs the chunks of a loop on a fixed set of worker threads and on the calling thread, and returns
+once every chunk is done. Chunks are claimed in no particular order, so a loop only gives the same
+result for every thread count if its chunks write to disjoint data and the caller combines per-chunk
+results in chunk order. Each worker has its own timeline in the trace, named "solver 1" onwards, with
+one event for the chunks it runs in each loop.
+*/
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeSignal;
+    std::condition_variable doneSignal;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    // The current loop. Every worker takes part in every loop, so none can still be
+    // claiming chunks of a loop when the next one is set up
+    void (*invoke)(void *, size_t) = nullptr;
+    void * body = nullptr;
+    size_t chunks = 0;
+    std::atomic<size_t> nextChunk{ 0 };
+    size_t pendingWorkers = 0;
+
+public:
+    // Starts threads - 1 workers, the calling thread is the last one
+    explicit ThreadPool(int threads) {
+        for (int i = 1; i < threads; ++i) workers.emplace_back([this, i] { run(i); });
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeSignal.notify_all();
+        for (std::thread & worker : workers) worker.join();
+    }
+
+    int threadCount() const {
+        return workers.size() + 1;
+    }
+
+    /**
+     * @brief Calls f(chunk) for every chunk in [0, count) and waits until all calls have returned.
+     * A single chunk is run on the calling thread without waking the workers
+     *
+     * @param count the number of chunks
+     * @param f the loop body, called concurrently from several threads
+     */
+    template <typename F>
+    void parallelFor(size_t count, F && f) {
+        if (workers.empty() || count <= 1) {
+            for (size_t chunk = 0; chunk < count; ++chunk) f(chunk);
+            return;
+        }
+        using Body = typename std::remove_reference<F>::type;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            invoke = [](void * context, size_t chunk) { (*static_cast<Body *>(context))(chunk); };
+            body = const_cast<void *>(static_cast<const void *>(&f));
+            chunks = count;
+            nextChunk.store(0);
+            pendingWorkers = workers.size();
+            ++generation;
+        }
+        wakeSignal.notify_all();
+        work(invoke, body, count);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        doneSignal.wait(lock, [this] { return pendingWorkers == 0; });
+    }
+
+private:
+    void run(int worker) {
+        bool traced = false;
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wakeSignal.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) break;
+            seen = generation;
+            void (*loopInvoke)(void *, size_t) = invoke;
+            void * loopBody = body;
+            size_t loopChunks = chunks;
+            lock.unlock();
+            // Workers only join the trace once it is enabled, and the workers of a later pool continue their timelines
+            if (!traced && Tracer::instance().isEnabled()) {
+                Tracer::instance().nameThread(("solver " + std::to_string(worker)).c_str());
+                traced = true;
+            }
+            work(loopInvoke, loopBody, loopChunks);
+            lock.lock();
+            if (--pendingWorkers == 0) doneSignal.notify_one();
+        }
+        lock.unlock();
+        if (traced) Tracer::instance().releaseThread();
+    }
+
+    void work(void (*loopInvoke)(void *, size_t), void * loopBody, size_t loopChunks) {
+        size_t chunk = nextChunk.fetch_add(1);
+        // A thread that finds every chunk already claimed leaves no event
+        if (chunk >= loopChunks) return;
+        TraceScope scope("chunks");
+        for (; chunk < loopChunks; chunk = nextChunk.fetch_add(1)) loopInvoke(loopBody, chunk);
+    }
+};
@@ -0,0 +1,245 @@
+/**
+ * @file trace.hpp
+ * @brief Writes timelines of every thread in the Chrome trace event format, viewable in chrome://tracing or Perfetto
+ * @date 2026-10-18
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+One timed scope. Names must be string literals, only the pointer is stored
+*/
+struct TraceEvent {
+    const char * name;
+    uint64_t start;
+    uint64_t duration;
+};
+
+/*
+The events of one thread in a single-producer single-consumer ring. The owning thread appends
+without locks or allocation, the flush thread drains it. Events that do not fit because the flush
+thread fell behind are dropped and counted.
+*/
+struct TraceBuffer {
+    static const uint64_t capacity = 1 << 14;
+
+    TraceEvent events[capacity];
+    std::atomic<uint64_t> head{ 0 };
+    std::atomic<uint64_t> tail{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+    uint32_t threadId = 0;
+    std::string threadName;
+    bool named = false;
+    // Set once the owning thread has ended, a later thread of the same name takes the buffer over
+    bool released = false;
+
+    void push(const TraceEvent & event) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= capacity) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        events[h % capacity] = event;
+        head.store(h + 1, std::memory_order_release);
+    }
+};
+
+/*
+Collects the trace events of all threads and streams them to a JSON file from a background thread.
+Each thread gets its own TraceBuffer the first time it records an event, so recording never waits
+for other threads or for the disk.
+*/
+class Tracer {
+    std::atomic<bool> enabled{ false };
+    std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    std::FILE * file = nullptr;
+    bool firstEvent = true;
+
+    std::thread flusher;
+    std::mutex flushMutex;
+    std::condition_variable flushSignal;
+    bool stopping = false;
+
+public:
+    // The tracer every TraceScope records into
+    static Tracer & instance() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    ~Tracer() {
+        stop();
+    }
+
+    bool isEnabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Opens the trace file and starts flushing events to it
+     *
+     * @return false if the file cannot be created
+     */
+    bool start(const std::string & path) {
+        file = std::fopen(path.c_str(), "w");
+        if (!file) {
+            std::cerr << "Could not create trace " << path << std::endl;
+            return false;
+        }
+        std::fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+        stopping = false;
+        flusher = std::thread([this] { run(); });
+        enabled.store(true);
+        return true;
+    }
+
+    // Stops recording, writes the remaining events and closes the file
+    void stop() {
+        if (!flusher.joinable()) return;
+        enabled.store(false);
+        {
+            std::lock_guard<std::mutex> lock(flushMutex);
+            stopping = true;
+        }
+        flushSignal.notify_one();
+        flusher.join();
+        drain();
+        std::fprintf(file, "\n]}\n");
+        std::fclose(file);
+        file = nullptr;
+
+        uint64_t dropped = 0;
+        for (const auto & buffer : buffers) dropped += buffer->dropped.load();
+        if (dropped > 0) std::cerr << dropped << " trace events were dropped" << std::endl;
+    }
+
+    /**
+     * @brief Names the calling thread in the trace. A thread that has not recorded anything yet continues the timeline
+     * of an ended thread of the same name, so threads that are replaced by new ones do not add timelines
+     *
+     */
+    void nameThread(const char * name) {
+        TraceBuffer *& current = currentBuffer();
+        if (!current) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto & buffer : buffers) {
+                if (!buffer->released || buffer->threadName != name) continue;
+                buffer->released = false;
+                current = buffer.get();
+                return;
+            }
+        }
+        TraceBuffer & buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(mutex);
+        buffer.threadName = name;
+    }
+
+    // Hands the buffer of the calling thread back before the thread ends, see nameThread()
+    void releaseThread() {
+        TraceBuffer *& current = currentBuffer();
+        if (!current) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        current->released = true;
+        current = nullptr;
+    }
+
+    // Nanoseconds since the tracer was created
+    uint64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    void record(const char * name, uint64_t start, uint64_t end) {
+        threadBuffer().push(TraceEvent{ name, start, end - start });
+    }
+
+private:
+    static TraceBuffer *& currentBuffer() {
+        thread_local TraceBuffer * buffer = nullptr;
+        return buffer;
+    }
+
+    TraceBuffer & threadBuffer() {
+        TraceBuffer *& buffer = currentBuffer();
+        if (!buffer) {
+            std::lock_guard<std::mutex> lock(mutex);
+            buffers.emplace_back(new TraceBuffer());
+            buffer = buffers.back().get();
+            buffer->threadId = buffers.size();
+            buffer->threadName = "thread " + std::to_string(buffer->threadId);
+        }
+        return *buffer;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(flushMutex);
+        while (!stopping) {
+            flushSignal.wait_for(lock, std::chrono::milliseconds(50));
+            lock.unlock();
+            drain();
+            lock.lock();
+        }
+    }
+
+    // Writes every event that has been recorded so far. Only called by one thread at a time
+    void drain() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto & buffer : buffers) {
+            if (!buffer->named) {
+                writeSeparator();
+                std::fprintf(file, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}}",
+                             buffer->threadId, buffer->threadName.c_str());
+                buffer->named = true;
+            }
+            uint64_t t = buffer->tail.load(std::memory_order_relaxed);
+            uint64_t h = buffer->head.load(std::memory_order_acquire);
+            for (; t < h; ++t) {
+                const TraceEvent & event = buffer->events[t % TraceBuffer::capacity];
+                writeSeparator();
+                std::fprintf(file, "{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+                             event.name, buffer->threadId, event.start / 1000.0, event.duration / 1000.0);
+            }
+            buffer->tail.store(h, std::memory_order_release);
+        }
+        std::fflush(file);
+    }
+
+    void writeSeparator() {
+        if (!firstEvent) std::fprintf(file, ",\n");
+        firstEvent = false;
+    }
+};
+
+/*
+Records the time from its construction to its destruction as a complete event on the calling thread's timeline
+*/
+class TraceScope {
+    const char * name;
+    uint64_t start;
+
+public:
+    explicit TraceScope(const char * name) : name(Tracer::instance().isEnabled() ? name : nullptr) {
+        if (this->name) start = Tracer::instance().now();
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope & operator=(const TraceScope &) = delete;
+
+    ~TraceScope() {
+        if (name) Tracer::instance().record(name, start, Tracer::instance().now());
+    }
+};